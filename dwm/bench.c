@@ -0,0 +1,441 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * bench grew out of transient.c. It starts dwm-bench (dwm built with
+ * TRACE) on a private Xvfb and maps a number of clients. Some clients have
+ * fixed size hints and some are transient for another. bench keeps
+ * changing their titles while it switches tags, layouts and focus through
+ * the ipc socket.
+ *
+ * Every operation writes one tab separated line to stdout:
+ *   command iteration latency-us settle-us events requests round-trips
+ * latency is the time from sending the command to the first
+ * ConfigureNotify, Expose or FocusIn on a bench window. settle is the time
+ * to the last one before SETTLE ms passed without any. Both are -1 if
+ * no event came. requests and round-trips are what dwm sent the X server
+ * meanwhile, as its trace command reports them. A summary per command
+ * goes to stderr.
+ */
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "util.h"
+
+#define LENGTH(X)               (sizeof X / sizeof X[0])
+#define SETTLE                  50   /* ms without events ending an operation */
+#define TIMEOUT                 2000 /* ms an operation may take at most */
+#define STARTUP                 5000 /* ms Xvfb and dwm may take to come up */
+
+typedef struct {
+	Window win;
+	long nexttitle;       /* msnow() of the next title change */
+	unsigned int titles;
+} BenchClient;
+
+/* commands run in every iteration, in order; each pair leaves dwm as it
+ * found it */
+static const char *ops[] = {
+	"view 2",
+	"view 1",
+	"setlayout 2",
+	"setlayout 0",
+	"focusstack 1",
+	"focusstack -1",
+	"incnmaster 1",
+	"incnmaster -1",
+	"zoom",
+	"zoom",
+};
+
+static Display *dpy;
+static BenchClient *clients;
+static unsigned int nclients = 20, titlehz = 10, iterations = 50;
+static const char *display = ":99", *sockpath;
+static const char *wmpath = "./dwm-bench", *xvfbpath = "Xvfb";
+static pid_t xvfb = -1, wm = -1;
+static int ipcfd = -1;
+static char ipcbuf[8192];
+static size_t ipclen;
+static char home[] = "/tmp/dwm-bench.XXXXXX";
+static char homesock[sizeof home + sizeof "/dwm.sock"];
+static int hashome;
+
+static long
+usnow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static long
+msnow(void)
+{
+	return usnow() / 1000;
+}
+
+static pid_t
+spawn(char *const argv[])
+{
+	pid_t pid;
+
+	if ((pid = fork()) < 0)
+		die("bench: fork:");
+	if (pid == 0) {
+		setsid();
+		execvp(argv[0], argv);
+		fprintf(stderr, "bench: execvp %s", argv[0]);
+		perror(" failed");
+		_exit(127);
+	}
+	return pid;
+}
+
+static int
+ipcconnect(void)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int fd;
+
+	strncpy(addr.sun_path, sockpath, sizeof addr.sun_path - 1);
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		die("bench: socket:");
+	if (connect(fd, (struct sockaddr *)&addr, sizeof addr) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* Reads the next line dwm sent into line, returns 0 when it hung up. */
+static int
+ipcline(char *line, size_t size)
+{
+	char *nl;
+	ssize_t r;
+	size_t len;
+
+	while (!(nl = memchr(ipcbuf, '\n', ipclen))) {
+		if (ipclen == sizeof ipcbuf)
+			die("bench: ipc line too long");
+		if ((r = read(ipcfd, ipcbuf + ipclen, sizeof ipcbuf - ipclen)) < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return 0;
+		ipclen += r;
+	}
+	len = MIN((size_t)(nl - ipcbuf), size - 1);
+	memcpy(line, ipcbuf, len);
+	line[len] = '\0';
+	ipclen -= nl + 1 - ipcbuf;
+	memmove(ipcbuf, nl + 1, ipclen);
+	return 1;
+}
+
+/* Runs cmd and waits for dwm to answer it. If reqs is given, the totals of
+ * a trace reply are stored there and in rtts. */
+static void
+ipccmd(const char *cmd, unsigned long *reqs, unsigned long *rtts)
+{
+	char line[512];
+	size_t len = strlen(cmd);
+
+	if (write(ipcfd, cmd, len) != (ssize_t)len || write(ipcfd, "\n", 1) != 1)
+		die("bench: ipc write:");
+	while (ipcline(line, sizeof line)) {
+		if (!strcmp(line, "ok"))
+			return;
+		if (!strncmp(line, "error:", 6))
+			die("bench: %s: %s", cmd, line);
+		if (reqs && sscanf(line, "total %lu %lu", reqs, rtts) == 2)
+			reqs = NULL;
+	}
+	die("bench: dwm hung up on %s", cmd);
+}
+
+/* Runs at exit, so it must not die() itself. */
+static void
+stop(void)
+{
+	long end = msnow() + STARTUP;
+
+	if (ipcfd >= 0) {
+		if (write(ipcfd, "quit\n", 5) != 5)
+			end = 0;
+		close(ipcfd);
+	}
+	if (wm > 0) {
+		while (waitpid(wm, NULL, WNOHANG) == 0 && msnow() < end)
+			usleep(50000);
+		if (kill(wm, SIGTERM) == 0)
+			waitpid(wm, NULL, 0);
+	}
+	if (dpy)
+		XCloseDisplay(dpy);
+	if (xvfb > 0) {
+		kill(xvfb, SIGTERM);
+		waitpid(xvfb, NULL, 0);
+	}
+	if (hashome) {
+		unlink(homesock);
+		rmdir(home);
+	}
+}
+
+static int
+isbench(Window w)
+{
+	unsigned int i;
+
+	for (i = 0; i < nclients; i++)
+		if (clients[i].win == w)
+			return 1;
+	return 0;
+}
+
+/* Changes the titles that are due, returns the msnow() the next one is. */
+static long
+ticktitles(void)
+{
+	char name[64];
+	long now = msnow(), next = now + TIMEOUT;
+	unsigned int i;
+
+	if (!titlehz)
+		return next;
+	for (i = 0; i < nclients; i++) {
+		if (clients[i].nexttitle <= now) {
+			snprintf(name, sizeof name, "bench %u, title %u", i, ++clients[i].titles);
+			XStoreName(dpy, clients[i].win, name);
+			clients[i].nexttitle = now + 1000 / titlehz;
+		}
+		next = MIN(next, clients[i].nexttitle);
+	}
+	XFlush(dpy);
+	return next;
+}
+
+/* Waits for what cmd causes to settle, returns the latency in us. */
+static long
+measure(const char *cmd, unsigned int iter)
+{
+	struct pollfd fd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+	unsigned long r0, r1, t0, t1;
+	long start, first = -1, last = -1, end, quiet, next;
+	unsigned int n = 0;
+	XEvent ev;
+
+	while (XPending(dpy)) /* what earlier operations caused */
+		XNextEvent(dpy, &ev);
+	ipccmd("trace", &r0, &t0);
+	start = usnow();
+	ipccmd(cmd, NULL, NULL);
+	end = msnow() + TIMEOUT;
+	quiet = msnow() + SETTLE;
+	for (;;) {
+		while (XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			if ((ev.type == ConfigureNotify || ev.type == Expose || ev.type == FocusIn)
+			&& isbench(ev.xany.window)) {
+				last = usnow() - start;
+				if (first < 0)
+					first = last;
+				n++;
+				quiet = msnow() + SETTLE;
+			}
+		}
+		next = MIN(ticktitles(), MIN(quiet, end));
+		if (msnow() >= MIN(quiet, end))
+			break;
+		poll(&fd, 1, MAX(0, next - msnow()));
+	}
+	ipccmd("trace", &r1, &t1);
+	printf("%s\t%u\t%ld\t%ld\t%u\t%lu\t%lu\n", cmd, iter, first, last, n,
+		r1 - r0, t1 - t0);
+	return first;
+}
+
+/* Maps every step-th client from from on and waits until dwm managed all
+ * of them. */
+static void
+mapclients(unsigned int from, unsigned int to, unsigned int step)
+{
+	struct pollfd fd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+	Window root = DefaultRootWindow(dpy);
+	XSizeHints h;
+	XEvent ev;
+	char name[64];
+	unsigned int i, n = 0;
+	long end;
+
+	for (i = from; i < to; i += step) {
+		clients[i].win = XCreateSimpleWindow(dpy, root, 10 * i, 10 * i,
+			200 + 10 * (i % 8), 150, 0, 0, WhitePixel(dpy, DefaultScreen(dpy)));
+		XSelectInput(dpy, clients[i].win, StructureNotifyMask|ExposureMask|FocusChangeMask);
+		if (i % 3 == 2) { /* fixed size, dwm floats it */
+			h.min_width = h.max_width = 300;
+			h.min_height = h.max_height = 200;
+			h.flags = PMinSize | PMaxSize;
+			XSetWMNormalHints(dpy, clients[i].win, &h);
+		}
+		if (i % 5 == 4 && i >= step) /* transient for an earlier one of its tag */
+			XSetTransientForHint(dpy, clients[i].win, clients[i - step].win);
+		snprintf(name, sizeof name, "bench %u", i);
+		XStoreName(dpy, clients[i].win, name);
+		XMapWindow(dpy, clients[i].win);
+		n++;
+	}
+	for (end = msnow() + STARTUP; n && msnow() < end; ) {
+		if (!XPending(dpy)) {
+			poll(&fd, 1, MAX(0, end - msnow()));
+			continue;
+		}
+		XNextEvent(dpy, &ev);
+		if (ev.type == MapNotify && isbench(ev.xmap.window))
+			n--;
+	}
+	if (n)
+		die("bench: dwm did not map %u clients", n);
+}
+
+static void
+waitwm(void)
+{
+	Atom check = XInternAtom(dpy, "_NET_SUPPORTING_WM_CHECK", False);
+	Atom type;
+	int format;
+	unsigned long nitems, after;
+	unsigned char *p;
+	long end = msnow() + STARTUP;
+
+	do {
+		p = NULL;
+		if (XGetWindowProperty(dpy, DefaultRootWindow(dpy), check, 0L, 1L, False,
+			XA_WINDOW, &type, &format, &nitems, &after, &p) == Success && p) {
+			XFree(p);
+			if (nitems)
+				break;
+		}
+		usleep(50000);
+	} while (msnow() < end);
+	while ((ipcfd = ipcconnect()) < 0 && msnow() < end)
+		usleep(50000);
+	if (ipcfd < 0)
+		die("bench: dwm did not come up on %s", display);
+}
+
+static int
+cmplong(const void *a, const void *b)
+{
+	return (*(long *)a > *(long *)b) - (*(long *)a < *(long *)b);
+}
+
+static void
+summary(long *lat)
+{
+	unsigned int i, j, n;
+	long *v = ecalloc(iterations, sizeof(long));
+
+	for (i = 0; i < LENGTH(ops); i++) {
+		for (n = j = 0; j < iterations; j++)
+			if (lat[j * LENGTH(ops) + i] >= 0)
+				v[n++] = lat[j * LENGTH(ops) + i];
+		qsort(v, n, sizeof(long), cmplong);
+		if (n)
+			fprintf(stderr, "%-14s n %3u  p50 %6ld us  p95 %6ld us  max %6ld us\n",
+				ops[i], n, v[n / 2], v[n * 95 / 100], v[n - 1]);
+		else
+			fprintf(stderr, "%-14s no events\n", ops[i]);
+	}
+	free(v);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char *xvfbargv[] = { (char *)xvfbpath, (char *)display, "-screen", "0",
+		"1920x1080x24", "-nolisten", "tcp", NULL };
+	char *wmargv[] = { (char *)wmpath, NULL };
+	unsigned int i, j;
+	long end, *lat;
+	char cmd[32];
+
+	for (i = 1; i < (unsigned int)argc; i++) {
+		if (i + 1 == (unsigned int)argc)
+			die("usage: bench [-n clients] [-r title-hz] [-i iterations] [-d display] [-s socket] [-w dwm] [-x Xvfb]");
+		else if (!strcmp(argv[i], "-n"))
+			nclients = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-r"))
+			titlehz = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-i"))
+			iterations = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-d"))
+			xvfbargv[1] = (char *)(display = argv[++i]);
+		else if (!strcmp(argv[i], "-s"))
+			sockpath = argv[++i];
+		else if (!strcmp(argv[i], "-w"))
+			wmargv[0] = (char *)(wmpath = argv[++i]);
+		else if (!strcmp(argv[i], "-x"))
+			xvfbargv[0] = (char *)(xvfbpath = argv[++i]);
+		else
+			die("bench: unknown option %s", argv[i]);
+	}
+	if (!nclients || !iterations)
+		die("bench: need at least one client and one iteration");
+	/* dwm-bench would refuse to start, say why */
+	if (sockpath && (ipcfd = ipcconnect()) >= 0)
+		die("bench: a dwm is listening on %s already", sockpath);
+
+	atexit(stop);
+	signal(SIGPIPE, SIG_IGN);
+	xvfb = spawn(xvfbargv);
+	for (end = msnow() + STARTUP; !(dpy = XOpenDisplay(display)); usleep(50000))
+		if (msnow() >= end)
+			die("bench: cannot open display %s", display);
+	/* keep the autostart scripts of the user out of it */
+	if (!mkdtemp(home))
+		die("bench: mkdtemp:");
+	hashome = 1;
+	/* by default dwm-bench gets a socket of its own in its HOME */
+	if (!sockpath) {
+		snprintf(homesock, sizeof homesock, "%s/dwm.sock", home);
+		sockpath = homesock;
+	}
+	setenv("HOME", home, 1);
+	setenv("DISPLAY", display, 1);
+	setenv("DWM_SOCKET", sockpath, 1);
+	wm = spawn(wmargv);
+	waitwm();
+
+	/* spread the clients over four tags */
+	clients = ecalloc(nclients, sizeof(BenchClient));
+	for (i = 0; i < 4 && i < nclients; i++) {
+		snprintf(cmd, sizeof cmd, "view %u", 1u << i);
+		ipccmd(cmd, NULL, NULL);
+		mapclients(i, nclients, 4);
+	}
+	ipccmd("view 1", NULL, NULL);
+
+	lat = ecalloc(iterations * LENGTH(ops), sizeof(long));
+	printf("command\titeration\tlatency-us\tsettle-us\tevents\trequests\tround-trips\n");
+	for (i = 0; i < iterations; i++)
+		for (j = 0; j < LENGTH(ops); j++)
+			lat[i * LENGTH(ops) + j] = measure(ops[j], i);
+	fflush(stdout);
+	summary(lat);
+	free(lat);
+	free(clients);
+	return EXIT_SUCCESS;
+}
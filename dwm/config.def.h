@@ -9,6 +9,7 @@ static const int usealtbar          = 1;        /* 1 means use non-dwm status ba
 static const char *altbarclass      = "Polybar"; /* Alternate bar class name */
 static const char *alttrayname      = "tray";    /* Polybar tray instance name */
 static const char *altbarcmd        = "$HOME/bar.sh"; /* Alternate bar launch command */
+static const unsigned int refreshrate = 60;     /* Hz, where XRandR cannot tell; caps bar redraws */
 static const char *fonts[]          = { "monospace:size=10" };
 static const char dmenufont[]       = "monospace:size=10";
 static const char col_gray1[]       = "#222222";
@@ -40,6 +41,7 @@ static const float mfact     = 0.55; /* factor of master area size [0.05..0.95]
 static const int nmaster     = 1;    /* number of clients in master area */
 static const int resizehints = 1;    /* 1 means respect size hints in tiled resizals */
 static const int lockfullscreen = 1; /* 1 will force focus on the fullscreen window */
+static const int hideunmap   = 0;    /* 1 unmaps clients on hidden tags instead of moving them away */
 
 static const Layout layouts[] = {
 	/* symbol     arrange function */
@@ -118,3 +120,25 @@ static Button buttons[] = {
 	{ ClkTagBar,            MODKEY,         Button3,        toggletag,      {0} },
 };
 
+/* ipc, see IPC in dwm(1) */
+static const int ipcsocket       = 1;               /* 0 disables the socket */
+static const char ipcstatussep[] = " | ";           /* between status segments */
+static const IpcCommand ipccommands[] = {
+	/* command          function        argument */
+	{ "view",           view,           IpcUint },
+	{ "toggleview",     toggleview,     IpcUint },
+	{ "tag",            tag,            IpcUint },
+	{ "toggletag",      toggletag,      IpcUint },
+	{ "setlayout",      setlayout,      IpcLayout },
+	{ "setmfact",       setmfact,       IpcFloat },
+	{ "incnmaster",     incnmaster,     IpcInt },
+	{ "focusstack",     focusstack,     IpcInt },
+	{ "focusmon",       focusmon,       IpcInt },
+	{ "tagmon",         tagmon,         IpcInt },
+	{ "zoom",           zoom,           IpcNone },
+	{ "togglefloating", togglefloating, IpcNone },
+	{ "togglebar",      togglebar,      IpcNone },
+	{ "killclient",     killclient,     IpcNone },
+	{ "quit",           quit,           IpcNone },
+};
+
@@ -14,6 +14,22 @@ X11LIB = /usr/X11R6/lib
 XINERAMALIBS  = -lXinerama
 XINERAMAFLAGS = -DXINERAMA
 
+# XCB, pipelines the startup scan, comment if you don't want it
+XCBLIBS  = -lX11-xcb -lxcb
+XCBFLAGS = -DXCB
+
+# XRandR, output hotplug and refresh rates, comment if you don't want it
+XRANDRLIBS  = -lXrandr
+XRANDRFLAGS = -DXRANDR
+
+# XSync, lets clients pace interactive resizes, comment if you don't want it
+XSYNCLIBS  = -lXext
+XSYNCFLAGS = -DXSYNC
+
+# latency tracing, dumped on SIGUSR1 and by the ipc trace command,
+# uncomment if you want it
+#TRACEFLAGS = -DTRACE
+
 # freetype
 FREETYPELIBS = -lfontconfig -lXft
 FREETYPEINC = /usr/include/freetype2
@@ -22,10 +38,10 @@ FREETYPEINC = /usr/include/freetype2
 
 # includes and libs
 INCS = -I${X11INC} -I${FREETYPEINC}
-LIBS = -L${X11LIB} -lX11 ${XINERAMALIBS} ${FREETYPELIBS}
+LIBS = -L${X11LIB} -lX11 ${XINERAMALIBS} ${XCBLIBS} ${XRANDRLIBS} ${XSYNCLIBS} ${FREETYPELIBS}
 
 # flags
-CPPFLAGS = -D_DEFAULT_SOURCE -D_BSD_SOURCE -D_POSIX_C_SOURCE=200809L -DVERSION=\"${VERSION}\" ${XINERAMAFLAGS}
+CPPFLAGS = -D_DEFAULT_SOURCE -D_BSD_SOURCE -D_POSIX_C_SOURCE=200809L -DVERSION=\"${VERSION}\" ${XINERAMAFLAGS} ${XCBFLAGS} ${XRANDRFLAGS} ${XSYNCFLAGS} ${TRACEFLAGS}
 #CFLAGS   = -g -std=c99 -pedantic -Wall -O0 ${INCS} ${CPPFLAGS}
 CFLAGS   = -std=c99 -pedantic -Wall -Wno-deprecated-declarations -Os ${INCS} ${CPPFLAGS}
 LDFLAGS  = ${LIBS}
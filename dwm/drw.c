@@ -10,12 +10,17 @@
 
 #define UTF_INVALID 0xFFFD
 #define UTF_SIZ     4
+#define BMP_SIZ     0x10000
+#define FALLBACK_MAX 16 /* fallback fonts kept open, least recently used go */
 
 static const unsigned char utfbyte[UTF_SIZ + 1] = {0x80,    0, 0xC0, 0xE0, 0xF0};
 static const unsigned char utfmask[UTF_SIZ + 1] = {0xC0, 0x80, 0xE0, 0xF0, 0xF8};
 static const long utfmin[UTF_SIZ + 1] = {       0,    0,  0x80,  0x800,  0x10000};
 static const long utfmax[UTF_SIZ + 1] = {0x10FFFF, 0x7F, 0x7FF, 0xFFFF, 0x10FFFF};
 
+/* cached for codepoints no font, not even a fontconfig fallback, can draw */
+static Fnt nofont;
+
 static long
 utf8decodebyte(const char c, size_t *i)
 {
@@ -71,6 +76,8 @@ drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h
 	drw->w = w;
 	drw->h = h;
 	drw->drawable = XCreatePixmap(dpy, root, w, h, DefaultDepth(dpy, screen));
+	drw->xftdraw = XftDrawCreate(dpy, drw->drawable, DefaultVisual(dpy, screen),
+	                             DefaultColormap(dpy, screen));
 	drw->gc = XCreateGC(dpy, root, 0, NULL);
 	XSetLineAttributes(dpy, drw->gc, 1, LineSolid, CapButt, JoinMiter);
 
@@ -88,14 +95,17 @@ drw_resize(Drw *drw, unsigned int w, unsigned int h)
 	if (drw->drawable)
 		XFreePixmap(drw->dpy, drw->drawable);
 	drw->drawable = XCreatePixmap(drw->dpy, drw->root, w, h, DefaultDepth(drw->dpy, drw->screen));
+	XftDrawChange(drw->xftdraw, drw->drawable);
 }
 
 void
 drw_free(Drw *drw)
 {
+	XftDrawDestroy(drw->xftdraw);
 	XFreePixmap(drw->dpy, drw->drawable);
 	XFreeGC(drw->dpy, drw->gc);
 	drw_fontset_free(drw->fonts);
+	free(drw->bmpcache);
 	free(drw);
 }
 
@@ -153,6 +163,193 @@ xfont_free(Fnt *font)
 	free(font);
 }
 
+/* Forget cached codepoint lookups resolving to font, or all of them if font
+ * is NULL. */
+static void
+fontcache_drop(Drw *drw, Fnt *font)
+{
+	size_t i;
+
+	/* widths depend on which fonts the characters resolved to */
+	memset(drw->widthcache, 0, sizeof(drw->widthcache));
+	if (drw->bmpcache)
+		for (i = 0; i < BMP_SIZ; i++)
+			if (!font || drw->bmpcache[i] == font)
+				drw->bmpcache[i] = NULL;
+	for (i = 0; i < FONTCACHE_ASTRAL; i++)
+		if (!font || drw->astralcache[i].font == font)
+			drw->astralcache[i].font = NULL;
+}
+
+static Fnt **
+fontcache_slot(Drw *drw, long codepoint)
+{
+	FntCacheEntry *e;
+
+	if (codepoint < BMP_SIZ) {
+		if (!drw->bmpcache)
+			drw->bmpcache = ecalloc(BMP_SIZ, sizeof(Fnt *));
+		return &drw->bmpcache[codepoint];
+	}
+	e = &drw->astralcache[(codepoint * 2654435761UL >> 16) % FONTCACHE_ASTRAL];
+	if (e->codepoint != codepoint) {
+		e->codepoint = codepoint;
+		e->font = NULL;
+	}
+	return &e->font;
+}
+
+/* Renders the queued glyphs, one request per color instead of one per
+ * string. */
+static void
+glyphs_flush(Drw *drw)
+{
+	XftGlyphFontSpec specs[GLYPHBATCH_SIZ];
+	Clr *clr;
+	unsigned int i, j, n;
+
+	for (i = 0; i < drw->nglyphs; i++) {
+		if (!(clr = drw->glyphclr[i]))
+			continue;
+		for (j = i, n = 0; j < drw->nglyphs; j++)
+			if (drw->glyphclr[j] == clr) {
+				specs[n++] = drw->glyphs[j];
+				drw->glyphclr[j] = NULL;
+			}
+		XftDrawGlyphFontSpec(drw->xftdraw, clr, specs, n);
+	}
+	drw->nglyphs = 0;
+}
+
+/* Closes the least recently used fallback font to make room for another. The
+ * font of the run drw_text is building was stamped just before, so it is never
+ * the one to go. Queued glyphs may still point at the others, so they are
+ * drawn first. */
+static void
+fallback_evict(Drw *drw)
+{
+	Fnt *f, *lru = NULL, **pf;
+
+	glyphs_flush(drw);
+	for (f = drw->fonts; f; f = f->next)
+		if (f->isfallback && (!lru || f->lastused < lru->lastused))
+			lru = f;
+	if (!lru)
+		return;
+	for (pf = &drw->fonts; *pf != lru; pf = &(*pf)->next)
+		; /* NOP */
+	*pf = lru->next;
+	fontcache_drop(drw, lru);
+	xfont_free(lru);
+	drw->nfallbacks--;
+}
+
+/* Asks fontconfig for a font that has codepoint and appends it to the font
+ * set. Returns NULL if there is none. */
+static Fnt *
+fallback_create(Drw *drw, long codepoint)
+{
+	Fnt *font, *curfont;
+	FcCharSet *fccharset;
+	FcPattern *fcpattern;
+	FcPattern *match;
+	XftResult result;
+
+	if (!drw->fonts->pattern) {
+		/* Refer to the comment in xfont_create for more information. */
+		die("the first font in the cache must be loaded from a font string.");
+	}
+
+	fccharset = FcCharSetCreate();
+	FcCharSetAddChar(fccharset, codepoint);
+
+	fcpattern = FcPatternDuplicate(drw->fonts->pattern);
+	FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
+	FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
+	FcPatternAddBool(fcpattern, FC_COLOR, FcFalse);
+
+	FcConfigSubstitute(NULL, fcpattern, FcMatchPattern);
+	FcDefaultSubstitute(fcpattern);
+	match = XftFontMatch(drw->dpy, drw->screen, fcpattern, &result);
+
+	FcCharSetDestroy(fccharset);
+	FcPatternDestroy(fcpattern);
+
+	if (!match)
+		return NULL;
+	font = xfont_create(drw, NULL, match);
+	if (!font || !XftCharExists(drw->dpy, font->xfont, codepoint)) {
+		xfont_free(font);
+		return NULL;
+	}
+
+	if (drw->nfallbacks >= FALLBACK_MAX)
+		fallback_evict(drw);
+	font->isfallback = 1;
+	drw->nfallbacks++;
+	for (curfont = drw->fonts; curfont->next; curfont = curfont->next)
+		; /* NOP */
+	curfont->next = font;
+	return font;
+}
+
+static unsigned int
+glyph_advance(Fnt *font, long codepoint)
+{
+	XGlyphInfo ext;
+	FT_UInt glyph;
+
+	if (font->advcache[codepoint & (ADVCACHE_SIZ - 1)].codepoint != codepoint) {
+		glyph = XftCharIndex(font->dpy, font->xfont, codepoint);
+		XftGlyphExtents(font->dpy, font->xfont, &glyph, 1, &ext);
+		font->advcache[codepoint & (ADVCACHE_SIZ - 1)].codepoint = codepoint;
+		font->advcache[codepoint & (ADVCACHE_SIZ - 1)].glyph = glyph;
+		font->advcache[codepoint & (ADVCACHE_SIZ - 1)].advance = ext.xOff;
+	}
+	return font->advcache[codepoint & (ADVCACHE_SIZ - 1)].advance;
+}
+
+static void
+glyph_queue(Drw *drw, Fnt *font, Clr *clr, long codepoint, int x, int y)
+{
+	XftGlyphFontSpec *g;
+
+	if (drw->nglyphs == GLYPHBATCH_SIZ)
+		glyphs_flush(drw);
+	glyph_advance(font, codepoint);
+	g = &drw->glyphs[drw->nglyphs];
+	g->font = font->xfont;
+	g->glyph = font->advcache[codepoint & (ADVCACHE_SIZ - 1)].glyph;
+	g->x = x;
+	g->y = y;
+	drw->glyphclr[drw->nglyphs++] = clr;
+}
+
+/* Returns the font to draw codepoint with. Lookups, including misses, are
+ * cached so the font set and fontconfig are only consulted once per
+ * codepoint. */
+static Fnt *
+fontset_lookup(Drw *drw, long codepoint)
+{
+	Fnt **slot, *font;
+
+	slot = fontcache_slot(drw, codepoint);
+	if (!(font = *slot)) {
+		for (font = drw->fonts; font; font = font->next)
+			if (XftCharExists(drw->dpy, font->xfont, codepoint))
+				break;
+		if (!font && !(font = fallback_create(drw, codepoint)))
+			font = &nofont;
+		/* fallback_create may have evicted a font and reset the slot */
+		*fontcache_slot(drw, codepoint) = font;
+	}
+	/* the character must be drawn, even if only as a missing glyph */
+	if (font == &nofont)
+		font = drw->fonts;
+	font->lastused = ++drw->fonttick;
+	return font;
+}
+
 Fnt*
 drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 {
@@ -168,6 +365,8 @@ drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 			ret = cur;
 		}
 	}
+	fontcache_drop(drw, NULL);
+	drw->nfallbacks = 0;
 	return (drw->fonts = ret);
 }
 
@@ -212,8 +411,14 @@ drw_scm_create(Drw *drw, const char *clrnames[], size_t clrcount)
 void
 drw_setfontset(Drw *drw, Fnt *set)
 {
-	if (drw)
-		drw->fonts = set;
+	Fnt *f;
+
+	if (!drw)
+		return;
+	drw->fonts = set;
+	fontcache_drop(drw, NULL);
+	for (drw->nfallbacks = 0, f = set; f; f = f->next)
+		drw->nfallbacks += f->isfallback;
 }
 
 void
@@ -223,6 +428,21 @@ drw_setscheme(Drw *drw, Clr *scm)
 		drw->scheme = scm;
 }
 
+/* Text drawn until drw_batch_end is queued and rendered all at once on top
+ * of whatever else was drawn meanwhile, so it must not overlap it. */
+void
+drw_batch_begin(Drw *drw)
+{
+	drw->batching = 1;
+}
+
+void
+drw_batch_end(Drw *drw)
+{
+	drw->batching = 0;
+	glyphs_flush(drw);
+}
+
 void
 drw_rect(Drw *drw, int x, int y, unsigned int w, unsigned int h, int filled, int invert)
 {
@@ -239,19 +459,15 @@ int
 drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert)
 {
 	char buf[1024];
-	int ty;
+	unsigned int pw[sizeof(buf)];   /* width of the first n characters of a run */
+	unsigned short off[sizeof(buf)]; /* and their length in bytes */
+	int tx, ty;
 	unsigned int ew;
-	XftDraw *d = NULL;
 	Fnt *usedfont, *curfont, *nextfont;
-	size_t i, len;
+	size_t i, n, lo, hi, len;
 	int utf8strlen, utf8charlen, render = x || y || w || h;
 	long utf8codepoint = 0;
 	const char *utf8str;
-	FcCharSet *fccharset;
-	FcPattern *fcpattern;
-	FcPattern *match;
-	XftResult result;
-	int charexists = 0;
 
 	if (!drw || (render && !drw->scheme) || !text || !drw->fonts)
 		return 0;
@@ -261,9 +477,6 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 	} else {
 		XSetForeground(drw->dpy, drw->gc, drw->scheme[invert ? ColFg : ColBg].pixel);
 		XFillRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w, h);
-		d = XftDrawCreate(drw->dpy, drw->drawable,
-		                  DefaultVisual(drw->dpy, drw->screen),
-		                  DefaultColormap(drw->dpy, drw->screen));
 		x += lpad;
 		w -= lpad;
 	}
@@ -273,95 +486,73 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 		utf8strlen = 0;
 		utf8str = text;
 		nextfont = NULL;
+		ew = pw[0] = off[0] = n = 0;
 		while (*text) {
 			utf8charlen = utf8decode(text, &utf8codepoint, UTF_SIZ);
-			for (curfont = drw->fonts; curfont; curfont = curfont->next) {
-				charexists = charexists || XftCharExists(drw->dpy, curfont->xfont, utf8codepoint);
-				if (charexists) {
-					if (curfont == usedfont) {
-						utf8strlen += utf8charlen;
-						text += utf8charlen;
-					} else {
-						nextfont = curfont;
-					}
-					break;
-				}
-			}
-
-			if (!charexists || nextfont)
+			curfont = fontset_lookup(drw, utf8codepoint);
+			if (curfont != usedfont) {
+				nextfont = curfont;
 				break;
-			else
-				charexists = 0;
+			}
+			ew += glyph_advance(usedfont, utf8codepoint);
+			if (off[n] + utf8charlen < sizeof(buf)) {
+				pw[n + 1] = ew;
+				off[n + 1] = off[n] + utf8charlen;
+				n++;
+			}
+			utf8strlen += utf8charlen;
+			text += utf8charlen;
 		}
 
 		if (utf8strlen) {
-			drw_font_getexts(usedfont, utf8str, utf8strlen, &ew, NULL);
-			/* shorten text if necessary */
-			for (len = MIN(utf8strlen, sizeof(buf) - 1); len && ew > w; len--)
-				drw_font_getexts(usedfont, utf8str, len, &ew, NULL);
+			/* shorten text if necessary, to the longest prefix that fits */
+			if (ew > w) {
+				for (lo = 0, hi = n; lo < hi;)
+					if (pw[(lo + hi + 1) / 2] <= w)
+						lo = (lo + hi + 1) / 2;
+					else
+						hi = (lo + hi + 1) / 2 - 1;
+				n = lo;
+				ew = pw[n];
+			}
+			len = off[n];
 
 			if (len) {
 				memcpy(buf, utf8str, len);
 				buf[len] = '\0';
-				if (len < utf8strlen)
-					for (i = len; i && i > len - 3; buf[--i] = '.')
+				if (len < utf8strlen) {
+					/* swap whole trailing characters for the ellipsis, or
+					 * like before, all of a prefix shorter than it */
+					for (i = n; i && off[n] - off[i] < 3; i--)
 						; /* NOP */
+					if (off[n] - off[i] >= 3) {
+						memcpy(buf + off[i], "...", 4);
+						len = off[i] + 3;
+					} else {
+						memset(buf, '.', len);
+					}
+				}
 
 				if (render) {
 					ty = y + (h - usedfont->h) / 2 + usedfont->xfont->ascent;
-					XftDrawStringUtf8(d, &drw->scheme[invert ? ColBg : ColFg],
-					                  usedfont->xfont, x, ty, (XftChar8 *)buf, len);
+					for (i = 0, tx = x; i < len; i += utf8charlen) {
+						utf8charlen = utf8decode(buf + i, &utf8codepoint, UTF_SIZ);
+						glyph_queue(drw, usedfont, &drw->scheme[invert ? ColBg : ColFg],
+						            utf8codepoint, tx, ty);
+						tx += glyph_advance(usedfont, utf8codepoint);
+					}
 				}
 				x += ew;
 				w -= ew;
 			}
 		}
 
-		if (!*text) {
+		if (!*text)
 			break;
-		} else if (nextfont) {
-			charexists = 0;
-			usedfont = nextfont;
-		} else {
-			/* Regardless of whether or not a fallback font is found, the
-			 * character must be drawn. */
-			charexists = 1;
-
-			fccharset = FcCharSetCreate();
-			FcCharSetAddChar(fccharset, utf8codepoint);
-
-			if (!drw->fonts->pattern) {
-				/* Refer to the comment in xfont_create for more information. */
-				die("the first font in the cache must be loaded from a font string.");
-			}
-
-			fcpattern = FcPatternDuplicate(drw->fonts->pattern);
-			FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
-			FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
-			FcPatternAddBool(fcpattern, FC_COLOR, FcFalse);
-
-			FcConfigSubstitute(NULL, fcpattern, FcMatchPattern);
-			FcDefaultSubstitute(fcpattern);
-			match = XftFontMatch(drw->dpy, drw->screen, fcpattern, &result);
-
-			FcCharSetDestroy(fccharset);
-			FcPatternDestroy(fcpattern);
-
-			if (match) {
-				usedfont = xfont_create(drw, NULL, match);
-				if (usedfont && XftCharExists(drw->dpy, usedfont->xfont, utf8codepoint)) {
-					for (curfont = drw->fonts; curfont->next; curfont = curfont->next)
-						; /* NOP */
-					curfont->next = usedfont;
-				} else {
-					xfont_free(usedfont);
-					usedfont = drw->fonts;
-				}
-			}
-		}
+		usedfont = nextfont;
 	}
-	if (d)
-		XftDrawDestroy(d);
+	if (render && !drw->batching)
+		glyphs_flush(drw);
 
 	return x + (render ? w : 0);
 }
@@ -372,16 +563,36 @@ drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h)
 	if (!drw)
 		return;
 
+	if (drw->nglyphs)
+		glyphs_flush(drw);
+	/* flushed along with everything else once the event queue runs dry */
 	XCopyArea(drw->dpy, drw->drawable, win, drw->gc, x, y, w, h, x, y);
-	XSync(drw->dpy, False);
 }
 
 unsigned int
 drw_fontset_getwidth(Drw *drw, const char *text)
 {
+	TextWidth *tw;
+	const char *p;
+	size_t len;
+	unsigned int w, hash = 2166136261U;
+
 	if (!drw || !drw->fonts || !text)
 		return 0;
-	return drw_text(drw, 0, 0, 0, 0, 0, text, 0);
+	if ((len = strlen(text)) >= sizeof(tw->text))
+		return drw_text(drw, 0, 0, 0, 0, 0, text, 0);
+
+	/* tags, layout symbols and the like are measured on every redraw */
+	for (p = text; *p; p++)
+		hash = (hash ^ (unsigned char)*p) * 16777619U;
+	tw = &drw->widthcache[hash % WIDTHCACHE_SIZ];
+	if (strcmp(tw->text, text)) {
+		/* measuring may evict a fallback font, which clears the cache */
+		w = drw_text(drw, 0, 0, 0, 0, 0, text, 0);
+		memcpy(tw->text, text, len + 1);
+		tw->w = w;
+	}
+	return tw->w;
 }
 
 void
@@ -4,26 +4,58 @@ typedef struct {
 	Cursor cursor;
 } Cur;
 
+#define ADVCACHE_SIZ 256 /* glyph advances cached per font, a power of two */
 typedef struct Fnt {
 	Display *dpy;
 	unsigned int h;
 	XftFont *xfont;
 	FcPattern *pattern;
+	int isfallback;         /* appended by drw_text for a missing glyph */
+	unsigned long lastused; /* fallback LRU stamp */
+	struct {
+		long codepoint;
+		FT_UInt glyph;
+		unsigned int advance;
+	} advcache[ADVCACHE_SIZ];
 	struct Fnt *next;
 } Fnt;
 
+#define FONTCACHE_ASTRAL 256 /* codepoint cache slots above the BMP */
+typedef struct {
+	long codepoint;
+	Fnt *font;
+} FntCacheEntry;
+
+#define WIDTHCACHE_SIZ 64 /* short strings whose fontset width is cached */
+typedef struct {
+	char text[32];
+	unsigned int w;
+} TextWidth;
+
 enum { ColFg, ColBg, ColBorder }; /* Clr scheme index */
 typedef XftColor Clr;
 
+#define GLYPHBATCH_SIZ 1024 /* glyphs queued before they are rendered */
+
 typedef struct {
 	unsigned int w, h;
 	Display *dpy;
 	int screen;
 	Window root;
 	Drawable drawable;
+	XftDraw *xftdraw;       /* bound to drawable for as long as it lives */
 	GC gc;
 	Clr *scheme;
 	Fnt *fonts;
+	Fnt **bmpcache;         /* codepoint -> font for the BMP, allocated lazily */
+	FntCacheEntry astralcache[FONTCACHE_ASTRAL];
+	unsigned long fonttick;
+	unsigned int nfallbacks;
+	TextWidth widthcache[WIDTHCACHE_SIZ];
+	int batching;           /* see drw_batch_begin */
+	unsigned int nglyphs;
+	XftGlyphFontSpec glyphs[GLYPHBATCH_SIZ];
+	Clr *glyphclr[GLYPHBATCH_SIZ];
 } Drw;
 
 /* Drawable abstraction */
@@ -50,6 +82,8 @@ void drw_setfontset(Drw *drw, Fnt *set);
 void drw_setscheme(Drw *drw, Clr *scm);
 
 /* Drawing functions */
+void drw_batch_begin(Drw *drw);
+void drw_batch_end(Drw *drw);
 void drw_rect(Drw *drw, int x, int y, unsigned int w, unsigned int h, int filled, int invert);
 int drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert);
 
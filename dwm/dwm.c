@@ -21,14 +21,20 @@
  * To understand everything else, start reading main().
  */
 #include <errno.h>
+#include <fcntl.h>
 #include <locale.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <X11/cursorfont.h>
 #include <X11/keysym.h>
@@ -39,6 +45,16 @@
 #ifdef XINERAMA
 #include <X11/extensions/Xinerama.h>
 #endif /* XINERAMA */
+#ifdef XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif /* XRANDR */
+#ifdef XSYNC
+#include <X11/extensions/sync.h>
+#endif /* XSYNC */
+#ifdef XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#endif /* XCB */
 #include <X11/Xft/Xft.h>
 
 #include "drw.h"
@@ -47,25 +63,71 @@
 /* macros */
 #define BUTTONMASK              (ButtonPressMask|ButtonReleaseMask)
 #define CLEANMASK(mask)         (mask & ~(numlockmask|LockMask) & (ShiftMask|ControlMask|Mod1Mask|Mod2Mask|Mod3Mask|Mod4Mask|Mod5Mask))
+#define REFRESH(m)              ((m)->refresh ? (m)->refresh : refreshrate)
 #define INTERSECT(x,y,w,h,m)    (MAX(0, MIN((x)+(w),(m)->mx+(m)->mw) - MAX((x),(m)->mx)) \
                                * MAX(0, MIN((y)+(h),(m)->my+(m)->mh) - MAX((y),(m)->my)))
 #define ISVISIBLE(C)            ((C->tags & C->mon->tagset[C->mon->seltags]))
 #define LENGTH(X)               (sizeof X / sizeof X[0])
 #define MOUSEMASK               (BUTTONMASK|PointerMotionMask)
+#define CLIENTMASK              (EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask)
+#define ROOTMASK                (SubstructureRedirectMask|SubstructureNotifyMask \
+                               |ButtonPressMask|PointerMotionMask|EnterWindowMask \
+                               |LeaveWindowMask|StructureNotifyMask|PropertyChangeMask)
 #define WIDTH(X)                ((X)->w + 2 * (X)->bw)
 #define HEIGHT(X)               ((X)->h + 2 * (X)->bw)
 #define TAGMASK                 ((1 << LENGTH(tags)) - 1)
 #define TEXTW(X)                (drw_fontset_getwidth(drw, (X)) + lrpad)
+#define IPCMAXCONNS             16
+#define LTCACHE_SIZ             8
+#define IPCSEGMENTS             8
+#define SYNCWAIT                100 /* ms a client may take to draw a size */
+#ifdef TRACE
+#define TRACEBUCKETS            20  /* log2 us latency histogram buckets */
+#define TRACERING               64  /* slow calls kept for tracedump() */
+#define TRACESLOW               4000 /* us from which a call counts as slow */
+#define TRACED(slot, win, call) do { TraceMark tm; tracebegin(&tm); call; \
+                                     traceend(&tm, slot, win); } while (0)
+/* the Xlib calls dwm makes that wait for a reply, counted as round trips */
+#define XGetClassHint(...)      (tracertts++, XGetClassHint(__VA_ARGS__))
+#define XGetModifierMapping(...) (tracertts++, XGetModifierMapping(__VA_ARGS__))
+#define XGetTextProperty(...)   (tracertts++, XGetTextProperty(__VA_ARGS__))
+#define XGetTransientForHint(...) (tracertts++, XGetTransientForHint(__VA_ARGS__))
+#define XGetWindowAttributes(...) (tracertts++, XGetWindowAttributes(__VA_ARGS__))
+#define XGetWindowProperty(...) (tracertts++, XGetWindowProperty(__VA_ARGS__))
+#define XGetWMHints(...)        (tracertts++, XGetWMHints(__VA_ARGS__))
+#define XGetWMNormalHints(...)  (tracertts++, XGetWMNormalHints(__VA_ARGS__))
+#define XGetWMProtocols(...)    (tracertts++, XGetWMProtocols(__VA_ARGS__))
+#define XGrabPointer(...)       (tracertts++, XGrabPointer(__VA_ARGS__))
+#define XInternAtom(...)        (tracertts++, XInternAtom(__VA_ARGS__))
+#define XQueryPointer(...)      (tracertts++, XQueryPointer(__VA_ARGS__))
+#define XQueryTree(...)         (tracertts++, XQueryTree(__VA_ARGS__))
+#define XSync(...)              (tracertts++, XSync(__VA_ARGS__))
+#define XSyncQueryCounter(...)  (tracertts++, XSyncQueryCounter(__VA_ARGS__))
+#define XRRGetCrtcInfo(...)     (tracertts++, XRRGetCrtcInfo(__VA_ARGS__))
+#define XRRGetScreenResourcesCurrent(...) (tracertts++, XRRGetScreenResourcesCurrent(__VA_ARGS__))
+#else
+#define TRACED(slot, win, call) call
+#endif /* TRACE */
 
 /* enums */
 enum { CurNormal, CurResize, CurMove, CurLast }; /* cursor */
 enum { SchemeNorm, SchemeSel }; /* color schemes */
 enum { NetSupported, NetWMName, NetWMState, NetWMCheck,
-       NetWMFullscreen, NetActiveWindow, NetWMWindowType,
-       NetWMWindowTypeDialog, NetClientList, NetLast }; /* EWMH atoms */
+       NetWMFullscreen, NetWMHidden, NetActiveWindow, NetWMWindowType,
+       NetWMWindowTypeDialog, NetClientList, NetClientListStacking,
+#ifdef XSYNC
+       NetWMSyncRequest, NetWMSyncRequestCounter,
+#endif /* XSYNC */
+       NetLast }; /* EWMH atoms */
 enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMLast }; /* default atoms */
 enum { ClkTagBar, ClkLtSymbol, ClkStatusText, ClkWinTitle,
        ClkClientWin, ClkRootWin, ClkLast }; /* clicks */
+enum { PendArrange = 1 << 0, PendRestack = 1 << 1, PendDraw = 1 << 2,
+       PendLazyDraw = 1 << 3 }; /* monitor work deferred to the end of a batch */
+enum { IpcNone, IpcInt, IpcUint, IpcFloat, IpcLayout }; /* ipc argument types */
+enum { GrabNone, GrabUnfocused, GrabFocused }; /* button grabs of a client */
+enum { BarSel = 1 << 0, BarUrg = 1 << 1, BarOcc = 1 << 2,
+       BarFilled = 1 << 3 }; /* state of a cached bar segment */
 
 typedef union {
 	int i;
@@ -93,6 +155,11 @@ struct Client {
 	int bw, oldbw;
 	unsigned int tags;
 	int isfixed, isfloating, isurgent, neverfocus, oldstate, isfullscreen;
+	int titlepending;
+	int ishidden;         /* told it is on a hidden tag */
+	int offscreen;        /* window moved away from x, y */
+	Window stackedbelow;  /* sibling restack last put it below, if tiled */
+	int grabbed;          /* Grab* state its buttons are in */
 	Client *next;
 	Client *snext;
 	Monitor *mon;
@@ -111,6 +178,39 @@ typedef struct {
 	void (*arrange)(Monitor *);
 } Layout;
 
+typedef struct {
+	const char *name;
+	void (*func)(const Arg *);
+	int argtype;          /* how the rest of the line becomes the Arg */
+} IpcCommand;
+
+typedef struct {
+	int fd;               /* -1 if the slot is free */
+	int subscribed;
+	size_t len;
+	char buf[1024];       /* incomplete command line */
+} IpcConn;
+
+typedef struct {
+	unsigned int tagset, occ, urg;
+	char ltsymbol[16];
+} IpcState;
+
+typedef struct {
+	char symbol[16];
+	Pixmap pix;
+} LtPixmap;
+
+typedef struct {
+	int valid;            /* 0 forces a full redraw */
+	int ww, tw, overlap;  /* bar and status width, status under the tags */
+	unsigned int seltags, occ, urg, filled;
+	char status[256];
+	char ltsymbol[16];
+	char title[256];
+	int titlestate;
+} BarState;
+
 struct Monitor {
 	char ltsymbol[16];
 	float mfact;
@@ -132,8 +232,94 @@ struct Monitor {
 	Window barwin;
 	Window traywin;
 	const Layout *lt[2];
+	BarState drawn;       /* what barwin currently shows */
+	unsigned int pending; /* Pend* work for the current event batch */
+	long lastdraw;        /* msnow() of the last bar redraw */
+	IpcState sent;        /* what ipc subscribers were last told */
+	unsigned int refresh; /* Hz, 0 if unknown */
+	int resized;          /* geometry changed, see updatemons() */
+#ifdef XRANDR
+	RROutput output;      /* output shown, None if unknown */
+#endif /* XRANDR */
 };
 
+typedef struct {
+	Window win;
+	Client *c;            /* managed client, or */
+	Monitor *m;           /* monitor owning the bar or tray window */
+} WinSlot;
+
+/* the window properties manage() is interested in */
+typedef struct {
+	char name[256];
+	Window trans;
+	char class[256], instance[256];
+	Atom state, wtype;
+	XSizeHints size;
+	XWMHints wmh;
+	int haswmh;
+} ManageProps;
+
+#ifdef XCB
+/* what scan() and maprequest() ask about a window in a single round trip */
+typedef struct {
+	Window win;
+	int ok;               /* geometry and attributes could be fetched */
+	XWindowAttributes wa; /* geometry, override_redirect and map_state */
+	int transient;
+	long state;
+	int hasclass;
+	char instance[128], class[128];
+	xcb_get_window_attributes_cookie_t attrs;
+	xcb_get_geometry_cookie_t geom;
+	xcb_get_property_cookie_t trans, wmclass, wmstate;
+} WinInfo;
+#endif /* XCB */
+
+#ifdef XSYNC
+/* _NET_WM_SYNC_REQUEST state of the client resizemouse() is resizing */
+typedef struct {
+	XSyncCounter counter;
+	XSyncAlarm alarm;     /* fires when counter reaches value */
+	XSyncValue value;     /* last value asked for */
+	int waiting;          /* the client has not drawn value yet */
+	long sent;            /* msnow() when value was asked for */
+} SyncState;
+#endif /* XSYNC */
+
+#ifdef XRANDR
+/* an active crtc, as randrgeom() sees it */
+typedef struct {
+	RROutput output;      /* first output of the crtc */
+	int x, y, w, h;
+	unsigned int refresh;
+	int used;             /* taken by a monitor */
+} RRScreen;
+#endif /* XRANDR */
+
+#ifdef TRACE
+enum { TraceArrange = LASTEvent, TraceRestack, TraceDrawbar, TraceManage,
+       TraceLast }; /* traced functions, after the traced event types */
+
+typedef struct {
+	unsigned long n, us, max;     /* calls, total and longest latency */
+	unsigned long reqs, rtts;     /* X requests sent, round trips waited */
+	unsigned long hist[TRACEBUCKETS]; /* calls taking [2^i, 2^(i+1)) us */
+} TraceStat;
+
+typedef struct {
+	long us;
+	unsigned long req, rtt;
+} TraceMark;
+
+typedef struct {
+	long when;                    /* msnow() at the end of the call */
+	int slot;
+	Window win;
+	unsigned long us, reqs, rtts;
+} TraceSlow;
+#endif /* TRACE */
+
 typedef struct {
 	const char *class;
 	const char *instance;
@@ -144,12 +330,14 @@ typedef struct {
 } Rule;
 
 /* function declarations */
-static void applyrules(Client *c);
+static void applyrules(Client *c, const char *class, const char *instance);
 static int applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact);
 static void arrange(Monitor *m);
 static void arrangemon(Monitor *m);
 static void attach(Client *c);
 static void attachstack(Client *c);
+static Pixmap barsegment(const char *text, unsigned int w, unsigned int state);
+static void barsegmentsfree(void);
 static void buttonpress(XEvent *e);
 static void checkotherwm(void);
 static void cleanup(void);
@@ -163,23 +351,42 @@ static void destroynotify(XEvent *e);
 static void detach(Client *c);
 static void detachstack(Client *c);
 static Monitor *dirtomon(int dir);
+static long dragdue(long last);
+static void dragevent(XEvent *ev, long timeout);
+static void dragmotion(XEvent *ev);
+static Bool dragpending(Display *d, XEvent *ev, XPointer arg);
 static void drawbar(Monitor *m);
 static void drawbars(void);
+static int drawdue(void);
 static void enternotify(XEvent *e);
 static void expose(XEvent *e);
+static void flushpending(void);
 static void focus(Client *c);
 static void focusin(XEvent *e);
 static void focusmon(const Arg *arg);
 static void focusstack(const Arg *arg);
-static Atom getatomprop(Client *c, Atom prop);
+static Atom getatomprop(Window w, Atom prop);
+static void getmanageprops(Window w, ManageProps *p);
 static int getrootptr(int *x, int *y);
+#ifndef XCB
 static long getstate(Window w);
+#endif /* XCB */
 static int gettextprop(Window w, Atom atom, char *text, unsigned int size);
 static void grabbuttons(Client *c, int focused);
 static void grabkeys(void);
 static void incnmaster(const Arg *arg);
+static void ipcaccept(void);
+static int ipcarg(int type, const char *s, Arg *a);
+static void ipcclose(IpcConn *cn);
+static void ipccommand(IpcConn *cn, char *line);
+static int ipcfds(struct pollfd *fds);
+static void ipcnotify(void);
+static void ipcread(struct pollfd *fds, int n);
+static void ipcsend(IpcConn *cn, const char *fmt, ...);
+static void ipcsetup(void);
 static void keypress(XEvent *e);
 static void killclient(const Arg *arg);
+static Pixmap ltpixmap(const char *symbol, unsigned int w);
 static void manage(Window w, XWindowAttributes *wa);
 static void managealtbar(Window win, XWindowAttributes *wa);
 static void managetray(Window win, XWindowAttributes *wa);
@@ -188,9 +395,11 @@ static void maprequest(XEvent *e);
 static void monocle(Monitor *m);
 static void motionnotify(XEvent *e);
 static void movemouse(const Arg *arg);
+static long msnow(void);
 static Client *nexttiled(Client *c);
 static void pop(Client *);
 static void propertynotify(XEvent *e);
+static void publishlist(Atom prop, Window *wins, size_t n, Window **last, size_t *lastn);
 static void quit(const Arg *arg);
 static Monitor *recttomon(int x, int y, int w, int h);
 static void resize(Client *c, int x, int y, int w, int h, int interact);
@@ -206,21 +415,41 @@ static void sendmon(Client *c, Monitor *m);
 static void setclientstate(Client *c, long state);
 static void setfocus(Client *c);
 static void setfullscreen(Client *c, int fullscreen);
+static void sethidden(Client *c, int hidden);
 static void setlayout(const Arg *arg);
 static void setmfact(const Arg *arg);
+static void setnetstate(Client *c);
+static void setsizehints(Client *c, XSizeHints *hints);
 static void setup(void);
 static void seturgent(Client *c, int urg);
+static void setwindowtype(Client *c, Atom state, Atom wtype);
+static void setwmhints(Client *c, XWMHints *wmh);
 static void showhide(Client *c);
 static void sigchld(int unused);
+#ifdef TRACE
+static void sigtrace(int unused);
+#endif /* TRACE */
 static void spawn(const Arg *arg);
 static void spawnbar();
+#ifdef XSYNC
+static void syncrequest(Client *c);
+static void syncstart(Client *c);
+static void syncstop(void);
+#endif /* XSYNC */
 static void tag(const Arg *arg);
 static void tagmon(const Arg *arg);
+static void textpropcopy(XTextProperty *name, char *text, unsigned int size);
 static void tile(Monitor *);
 static void togglebar(const Arg *arg);
 static void togglefloating(const Arg *arg);
 static void toggletag(const Arg *arg);
 static void toggleview(const Arg *arg);
+#ifdef TRACE
+static void tracebegin(TraceMark *tm);
+static void tracedump(IpcConn *cn, int reset);
+static void traceend(TraceMark *tm, int slot, Window win);
+static void traceout(IpcConn *cn, const char *fmt, ...);
+#endif /* TRACE */
 static void unfocus(Client *c, int setfocus);
 static void unmanage(Client *c, int destroyed);
 static void unmanagealtbar(Window w);
@@ -230,6 +459,7 @@ static void updatebarpos(Monitor *m);
 static void updatebars(void);
 static void updateclientlist(void);
 static int updategeom(void);
+static void updatemons(void);
 static void updatenumlockmask(void);
 static void updatesizehints(Client *c);
 static void updatestatus(void);
@@ -237,9 +467,19 @@ static void updatetitle(Client *c);
 static void updatewindowtype(Client *c);
 static void updatewmhints(Client *c);
 static void view(const Arg *arg);
+static void winindexdel(Window w);
+static WinSlot *winindexget(Window w);
+static void winindexput(Window w, Client *c, Monitor *m);
+#ifdef XCB
+static int wininfoclasscontains(WinInfo *wi, const char *class, const char *name);
+static void wininfofetch(WinInfo *wi);
+static void wininforeply(WinInfo *wi);
+#endif /* XCB */
 static Client *wintoclient(Window w);
 static Monitor *wintomon(Window w);
+#ifndef XCB
 static int wmclasscontains(Window win, const char *class, const char *name);
+#endif /* XCB */
 static int xerror(Display *dpy, XErrorEvent *ee);
 static int xerrordummy(Display *dpy, XErrorEvent *ee);
 static int xerrorstart(Display *dpy, XErrorEvent *ee);
@@ -272,12 +512,65 @@ static void (*handler[LASTEvent]) (XEvent *) = {
 };
 static Atom wmatom[WMLast], netatom[NetLast];
 static int running = 1;
+static int batching = 0;     /* defer arrange, restack and drawbar */
+static int statuspending = 0, titlespending = 0;
+static int geompending = 0;  /* monitors to be updated, see updatemons() */
+#ifdef XRANDR
+static int rrevbase = -1;    /* first XRandR event, -1 without XRandR */
+#endif /* XRANDR */
+#ifdef XSYNC
+static int syncevbase = -1, syncerrbase = -1; /* -1 without XSync */
+static SyncState dragsync;
+#endif /* XSYNC */
+#ifdef TRACE
+static TraceStat tracestats[TraceLast];
+static TraceSlow traceslow[TRACERING];
+static unsigned int traceslowpos;
+static unsigned long tracertts;
+static volatile sig_atomic_t tracesig;
+static const char *tracenames[TraceLast] = {
+	[ButtonPress] = "ButtonPress",
+	[ClientMessage] = "ClientMessage",
+	[ConfigureRequest] = "ConfigureRequest",
+	[ConfigureNotify] = "ConfigureNotify",
+	[DestroyNotify] = "DestroyNotify",
+	[EnterNotify] = "EnterNotify",
+	[Expose] = "Expose",
+	[FocusIn] = "FocusIn",
+	[KeyPress] = "KeyPress",
+	[MappingNotify] = "MappingNotify",
+	[MapRequest] = "MapRequest",
+	[MotionNotify] = "MotionNotify",
+	[PropertyNotify] = "PropertyNotify",
+	[UnmapNotify] = "UnmapNotify",
+	[TraceArrange] = "arrange",
+	[TraceRestack] = "restack",
+	[TraceDrawbar] = "drawbar",
+	[TraceManage] = "manage"
+};
+#endif /* TRACE */
 static Cur *cursor[CurLast];
 static Clr **scheme;
 static Display *dpy;
 static Drw *drw;
 static Monitor *mons, *selmon;
 static Window root, wmcheckwin;
+static WinSlot *wintab;      /* window index, open addressing, linear probing */
+static size_t wintabsz, wintabused;
+static int ipcfd = -1;
+static char ipcpath[sizeof ((struct sockaddr_un *)0)->sun_path];
+static IpcConn ipcconns[IPCMAXCONNS];
+static char ipcseg[IPCSEGMENTS][256]; /* status text set over ipc */
+static int ipcresync;                 /* tell subscribers everything again */
+static Window ipcselwin;
+static int ipcselmon = -1;
+static LtPixmap ltpix[LTCACHE_SIZ];
+static int clientlistdirty;
+static Window *netclients, *netstacking; /* as last set on the root window */
+static size_t nnetclients, nnetstacking;
+static Client **hidebuf; /* scratch for showhide */
+static size_t hidebufsz;
+static unsigned int ltpixnext;
 
 /* configuration, allows nested code to access above variables */
 #include "config.h"
@@ -285,23 +578,20 @@ static Window root, wmcheckwin;
 /* compile-time check if all tags fit into an unsigned int bit array. */
 struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
 
+/* every tag label as it looks in each Bar* state, rendered on first use */
+static Pixmap tagpix[LENGTH(tags)][16];
+
 /* function implementations */
 void
-applyrules(Client *c)
+applyrules(Client *c, const char *class, const char *instance)
 {
-	const char *class, *instance;
 	unsigned int i;
 	const Rule *r;
 	Monitor *m;
-	XClassHint ch = { NULL, NULL };
 
 	/* rule matching */
 	c->isfloating = 0;
 	c->tags = 0;
-	XGetClassHint(dpy, c->win, &ch);
-	class    = ch.res_class ? ch.res_class : broken;
-	instance = ch.res_name  ? ch.res_name  : broken;
-
 	for (i = 0; i < LENGTH(rules); i++) {
 		r = &rules[i];
 		if ((!r->title || strstr(c->name, r->title))
@@ -315,10 +605,6 @@ applyrules(Client *c)
 				c->mon = m;
 		}
 	}
-	if (ch.res_class)
-		XFree(ch.res_class);
-	if (ch.res_name)
-		XFree(ch.res_name);
 	c->tags = c->tags & TAGMASK ? c->tags & TAGMASK : c->mon->tagset[c->mon->seltags];
 }
 
@@ -391,6 +677,13 @@ applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact)
 void
 arrange(Monitor *m)
 {
+	Monitor *t;
+
+	if (batching) {
+		for (t = m ? m : mons; t; t = m ? NULL : t->next)
+			t->pending |= m ? PendArrange|PendRestack : PendArrange;
+		return;
+	}
 	if (m)
 		showhide(m->stack);
 	else for (m = mons; m; m = m->next)
@@ -415,6 +708,8 @@ attach(Client *c)
 {
 	c->next = c->mon->clients;
 	c->mon->clients = c;
+	winindexput(c->win, c, NULL);
+	clientlistdirty = 1;
 }
 
 void
@@ -422,6 +717,45 @@ attachstack(Client *c)
 {
 	c->snext = c->mon->stack;
 	c->mon->stack = c;
+	clientlistdirty = 1;
+}
+
+/* Renders text in a bar segment of width w into a pixmap of its own, which
+ * redraws then only have to copy. */
+Pixmap
+barsegment(const char *text, unsigned int w, unsigned int state)
+{
+	Pixmap p = XCreatePixmap(dpy, root, w, bh, DefaultDepth(dpy, screen));
+	int boxs = drw->fonts->h / 9;
+	int boxw = drw->fonts->h / 6 + 2;
+
+	drw_setscheme(drw, scheme[state & BarSel ? SchemeSel : SchemeNorm]);
+	drw_text(drw, 0, 0, w, bh, lrpad / 2, text, state & BarUrg);
+	if (state & BarOcc)
+		drw_rect(drw, boxs, boxs, boxw, boxw, state & BarFilled, state & BarUrg);
+	drw_map(drw, p, 0, 0, w, bh);
+	return p;
+}
+
+/* Drops the rendered tags and layout symbols. They stay valid as long as the
+ * fonts, colors and bar height do, so call this when any of them changes. */
+void
+barsegmentsfree(void)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < LENGTH(tags); i++)
+		for (j = 0; j < LENGTH(tagpix[i]); j++)
+			if (tagpix[i][j]) {
+				XFreePixmap(dpy, tagpix[i][j]);
+				tagpix[i][j] = 0;
+			}
+	for (i = 0; i < LTCACHE_SIZ; i++)
+		if (ltpix[i].pix) {
+			XFreePixmap(dpy, ltpix[i].pix);
+			ltpix[i].pix = 0;
+			ltpix[i].symbol[0] = '\0';
+		}
 }
 
 void
@@ -457,8 +791,13 @@ buttonpress(XEvent *e)
 	} else if ((c = wintoclient(ev->window))) {
 		focus(c);
 		restack(selmon);
-		XAllowEvents(dpy, ReplayPointer, CurrentTime);
 		click = ClkClientWin;
+		/* the grab froze the pointer, pass on what is not a binding */
+		for (i = 0; i < LENGTH(buttons); i++)
+			if (buttons[i].click == ClkClientWin && buttons[i].button == ev->button
+			&& CLEANMASK(buttons[i].mask) == CLEANMASK(ev->state))
+				break;
+		XAllowEvents(dpy, i < LENGTH(buttons) ? AsyncPointer : ReplayPointer, CurrentTime);
 	}
 	for (i = 0; i < LENGTH(buttons); i++)
 		if (click == buttons[i].click && buttons[i].func && buttons[i].button == ev->button
@@ -495,10 +834,22 @@ cleanup(void)
 		cleanupmon(mons);
 	for (i = 0; i < CurLast; i++)
 		drw_cur_free(drw, cursor[i]);
+	barsegmentsfree();
 	for (i = 0; i < LENGTH(colors); i++)
 		free(scheme[i]);
 	XDestroyWindow(dpy, wmcheckwin);
 	drw_free(drw);
+	free(wintab);
+	free(netclients);
+	free(netstacking);
+	free(hidebuf);
+	for (i = 0; i < LENGTH(ipcconns); i++)
+		if (ipcconns[i].fd >= 0)
+			close(ipcconns[i].fd);
+	if (ipcfd >= 0) {
+		close(ipcfd);
+		unlink(ipcpath);
+	}
 	XSync(dpy, False);
 	XSetInputFocus(dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
 	XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
@@ -515,6 +866,8 @@ cleanupmon(Monitor *mon)
 		for (m = mons; m && m->next != mon; m = m->next);
 		m->next = mon->next;
 	}
+	winindexdel(mon->barwin);
+	winindexdel(mon->traywin);
 	if (!usealtbar) {
 		XUnmapWindow(dpy, mon->barwin);
 		XDestroyWindow(dpy, mon->barwin);
@@ -563,28 +916,12 @@ configure(Client *c)
 void
 configurenotify(XEvent *e)
 {
-	Monitor *m;
-	Client *c;
 	XConfigureEvent *ev = &e->xconfigure;
-	int dirty;
 
-	/* TODO: updategeom handling sucks, needs to be simplified */
 	if (ev->window == root) {
-		dirty = (sw != ev->width || sh != ev->height);
 		sw = ev->width;
 		sh = ev->height;
-		if (updategeom() || dirty) {
-			drw_resize(drw, sw, bh);
-			updatebars();
-			for (m = mons; m; m = m->next) {
-				for (c = m->clients; c; c = c->next)
-					if (c->isfullscreen)
-						resizeclient(c, m->mx, m->my, m->mw, m->mh);
-				XMoveResizeWindow(dpy, m->barwin, m->wx, m->by, m->ww, m->bh);
-			}
-			focus(NULL);
-			arrange(NULL);
-		}
+		geompending = 1;
 	}
 }
 
@@ -637,7 +974,6 @@ configurerequest(XEvent *e)
 		wc.stack_mode = ev->detail;
 		XConfigureWindow(dpy, ev->window, ev->value_mask, &wc);
 	}
-	XSync(dpy, False);
 }
 
 Monitor *
@@ -680,6 +1016,8 @@ detach(Client *c)
 
 	for (tc = &c->mon->clients; *tc && *tc != c; tc = &(*tc)->next);
 	*tc = c->next;
+	winindexdel(c->win);
+	clientlistdirty = 1;
 }
 
 void
@@ -689,6 +1027,7 @@ detachstack(Client *c)
 
 	for (tc = &c->mon->stack; *tc && *tc != c; tc = &(*tc)->snext);
 	*tc = c->snext;
+	clientlistdirty = 1;
 
 	if (c == c->mon->sel) {
 		for (t = c->mon->stack; t && !ISVISIBLE(t); t = t->snext);
@@ -711,57 +1050,193 @@ dirtomon(int dir)
 	return m;
 }
 
+/* Returns the ms until the next step of a move or resize may be shown:
+ * one per refresh of the monitor, and not before the client drew the last
+ * size or took too long for it. */
+long
+dragdue(long last)
+{
+	long due = MAX(0, last + 1000 / REFRESH(selmon) - msnow());
+
+#ifdef XSYNC
+	if (dragsync.waiting)
+		due = MAX(due, dragsync.sent + SYNCWAIT - msnow());
+#endif /* XSYNC */
+	return due;
+}
+
+/* Waits up to timeout ms, or forever if it is negative, for an event of
+ * the move and resize loops. ev->type is 0 if none came. */
+void
+dragevent(XEvent *ev, long timeout)
+{
+	struct pollfd fd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+	long end = msnow() + timeout;
+
+	for (;;) {
+		if (timeout < 0) {
+			XMaskEvent(dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, ev);
+			return;
+		}
+		if (XCheckMaskEvent(dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, ev))
+			return;
+#ifdef XSYNC
+		if (syncevbase >= 0 && XCheckTypedEvent(dpy, syncevbase + XSyncAlarmNotify, ev))
+			return;
+#endif /* XSYNC */
+		if ((timeout = end - msnow()) <= 0 || poll(&fd, 1, timeout) <= 0) {
+			ev->type = 0;
+			return;
+		}
+	}
+}
+
+/* Replaces the MotionNotify in ev by the last one queued before the next
+ * ButtonRelease, which is all that matters of them. */
+void
+dragmotion(XEvent *ev)
+{
+	XEvent next;
+	int released;
+
+	for (released = 0; XCheckIfEvent(dpy, &next, dragpending, (XPointer)&released); released = 0)
+		*ev = next;
+}
+
+/* XCheckIfEvent predicate for the motion events before the first release */
+Bool
+dragpending(Display *d, XEvent *ev, XPointer arg)
+{
+	int *released = (int *)arg;
+
+	if (ev->type == ButtonRelease)
+		*released = 1;
+	return !*released && ev->type == MotionNotify;
+}
+
 void
 drawbar(Monitor *m)
 {
 	if (usealtbar)
 		return;
+	if (batching) {
+		m->pending |= PendDraw;
+		return;
+	}
+	m->lastdraw = msnow();
 
-	int x, w, tw = 0;
+	int x, w, tw = 0, tagsw = 0, full, titlestate, ltdirty;
 	int boxs = drw->fonts->h / 9;
 	int boxw = drw->fonts->h / 6 + 2;
-	unsigned int i, occ = 0, urg = 0;
+	/* dirty segments and where they are rendered, 0 for the drw pixmap */
+	int mapx[LENGTH(tags) + 3], mapw[LENGTH(tags) + 3];
+	Pixmap mapsrc[LENGTH(tags) + 3];
+	unsigned int i, n = 0, st, occ = 0, urg = 0, filled = 0, tagdirty;
+	const char *title = "";
+	BarState *b = &m->drawn;
 	Client *c;
 
-	/* draw status first so it can be overdrawn by tags later */
-	if (m == selmon) { /* status is only drawn on selected monitor */
-		drw_setscheme(drw, scheme[SchemeNorm]);
+	/* Only the segments whose content or position changed are rendered and
+	 * copied to barwin; the pixmap is shared by all bars, so nothing else in
+	 * it can be relied upon. */
+	if (m == selmon) /* status is only drawn on selected monitor */
 		tw = TEXTW(stext) - lrpad + 2; /* 2px right padding */
-		drw_text(drw, m->ww - tw, 0, tw, bh, 0, stext, 0);
-	}
-
 	for (c = m->clients; c; c = c->next) {
 		occ |= c->tags;
 		if (c->isurgent)
 			urg |= c->tags;
 	}
-	x = 0;
-	for (i = 0; i < LENGTH(tags); i++) {
-		w = TEXTW(tags[i]);
-		drw_setscheme(drw, scheme[m->tagset[m->seltags] & 1 << i ? SchemeSel : SchemeNorm]);
-		drw_text(drw, x, 0, w, bh, lrpad / 2, tags[i], urg & 1 << i);
-		if (occ & 1 << i)
-			drw_rect(drw, x + boxs, boxs, boxw, boxw,
-				m == selmon && selmon->sel && selmon->sel->tags & 1 << i,
-				urg & 1 << i);
-		x += w;
-	}
-	w = blw = TEXTW(m->ltsymbol);
-	drw_setscheme(drw, scheme[SchemeNorm]);
-	x = drw_text(drw, x, 0, w, bh, lrpad / 2, m->ltsymbol, 0);
-
+	if (m == selmon && selmon->sel)
+		filled = selmon->sel->tags;
+	for (i = 0; i < LENGTH(tags); i++)
+		tagsw += TEXTW(tags[i]);
+	blw = TEXTW(m->ltsymbol);
+	x = tagsw + blw;
 	if ((w = m->ww - tw - x) > bh) {
 		if (m->sel) {
+			title = m->sel->name;
+			titlestate = 1 | (m == selmon) << 1 | m->sel->isfloating << 2
+				| m->sel->isfixed << 3;
+		} else
+			titlestate = 0;
+	} else
+		titlestate = -1;
+
+	/* a status running under the tags can only be drawn along with them */
+	full = !b->valid || b->ww != m->ww || b->overlap || tw > m->ww - x;
+	tagdirty = full ? ~0 : (m->tagset[m->seltags] ^ b->seltags) | (occ ^ b->occ)
+		| (urg ^ b->urg) | ((filled ^ b->filled) & occ);
+	ltdirty = full || strcmp(b->ltsymbol, m->ltsymbol);
+
+	/* all text of the bar goes out in one batch, unless the status runs
+	 * under the tags: it is drawn first so they can overdraw it */
+	drw_batch_begin(drw);
+	if (tw && (full || b->tw != tw || strcmp(b->status, stext))) {
+		drw_setscheme(drw, scheme[SchemeNorm]);
+		drw_text(drw, m->ww - tw, 0, tw, bh, 0, stext, 0);
+		if (tw > m->ww - x) {
+			drw_batch_end(drw);
+			drw_batch_begin(drw);
+		}
+		mapsrc[n] = 0;
+		mapx[n] = m->ww - tw;
+		mapw[n++] = tw;
+	}
+	for (i = 0, x = 0; i < LENGTH(tags); i++, x += w) {
+		w = TEXTW(tags[i]);
+		if (!(tagdirty & 1 << i))
+			continue;
+		st = (m->tagset[m->seltags] & 1 << i ? BarSel : 0)
+			| (urg & 1 << i ? BarUrg : 0) | (occ & 1 << i ? BarOcc : 0)
+			| (filled & 1 << i ? BarFilled : 0);
+		if (!tagpix[i][st])
+			tagpix[i][st] = barsegment(tags[i], w, st);
+		mapsrc[n] = tagpix[i][st];
+		mapx[n] = x;
+		mapw[n++] = w;
+	}
+	if (ltdirty) {
+		mapsrc[n] = ltpixmap(m->ltsymbol, blw);
+		mapx[n] = x;
+		mapw[n++] = blw;
+	}
+	x += blw;
+
+	w = m->ww - tw - x;
+	if (w > 0 && (ltdirty || b->tw != tw || b->titlestate != titlestate
+	|| strcmp(b->title, title))) {
+		if (titlestate > 0) {
 			drw_setscheme(drw, scheme[m == selmon ? SchemeSel : SchemeNorm]);
-			drw_text(drw, x, 0, w, bh, lrpad / 2, m->sel->name, 0);
+			drw_text(drw, x, 0, w, bh, lrpad / 2, title, 0);
 			if (m->sel->isfloating)
 				drw_rect(drw, x + boxs, boxs, boxw, boxw, m->sel->isfixed, 0);
 		} else {
 			drw_setscheme(drw, scheme[SchemeNorm]);
 			drw_rect(drw, x, 0, w, bh, 1, 1);
 		}
+		mapsrc[n] = 0;
+		mapx[n] = x;
+		mapw[n++] = w;
 	}
-	drw_map(drw, m->barwin, 0, 0, m->ww, bh);
+	drw_batch_end(drw);
+	for (i = 0; i < n; i++)
+		if (mapsrc[i])
+			XCopyArea(dpy, mapsrc[i], m->barwin, drw->gc, 0, 0, mapw[i], bh, mapx[i], 0);
+		else
+			drw_map(drw, m->barwin, mapx[i], 0, mapw[i], bh);
+
+	b->valid = 1;
+	b->ww = m->ww;
+	b->tw = tw;
+	b->overlap = tw > m->ww - x;
+	b->seltags = m->tagset[m->seltags];
+	b->occ = occ;
+	b->urg = urg;
+	b->filled = filled;
+	b->titlestate = titlestate;
+	strcpy(b->status, tw ? stext : "");
+	strcpy(b->ltsymbol, m->ltsymbol);
+	strcpy(b->title, title);
 }
 
 void
@@ -773,6 +1248,23 @@ drawbars(void)
 		drawbar(m);
 }
 
+/* Returns the milliseconds until a throttled bar redraw is due, or -1 if
+ * there is none. */
+int
+drawdue(void)
+{
+	Monitor *m;
+	long t, due = -1;
+
+	for (m = mons; m; m = m->next)
+		if (m->pending & PendLazyDraw) {
+			t = MAX(0, m->lastdraw + 1000 / REFRESH(m) - msnow());
+			if (due < 0 || t < due)
+				due = t;
+		}
+	return due;
+}
+
 void
 enternotify(XEvent *e)
 {
@@ -798,8 +1290,68 @@ expose(XEvent *e)
 	Monitor *m;
 	XExposeEvent *ev = &e->xexpose;
 
-	if (ev->count == 0 && (m = wintomon(ev->window)))
-		drawbar(m);
+	if ((m = wintomon(ev->window)) && ev->window == m->barwin) {
+		m->drawn.valid = 0;
+		if (ev->count == 0)
+			drawbar(m);
+	}
+}
+
+/* Performs the arrange, restack and drawbar calls deferred while handling a
+ * batch of events, each at most once per monitor. */
+void
+flushpending(void)
+{
+	Client *c;
+	Monitor *m;
+	unsigned int pending;
+	int b = batching;
+
+	batching = 0;
+	/* plugging an output sends a burst of events, handle them at once */
+	if (geompending) {
+		geompending = 0;
+		updatemons();
+	}
+	/* however often they changed, titles and status are read once and
+	 * redrawn at most once per refresh of their monitor */
+	if (statuspending) {
+		statuspending = 0;
+		updatestatus();
+	}
+	if (titlespending) {
+		titlespending = 0;
+		for (m = mons; m; m = m->next)
+			for (c = m->clients; c; c = c->next)
+				if (c->titlepending) {
+					c->titlepending = 0;
+					updatetitle(c);
+					if (c == m->sel)
+						m->pending |= PendLazyDraw;
+				}
+	}
+	for (m = mons; m; m = m->next) {
+		pending = m->pending;
+		m->pending = 0;
+		if (pending & PendArrange) {
+			showhide(m->stack);
+			TRACED(TraceArrange, m->barwin, arrangemon(m));
+		}
+		if (pending & PendRestack)
+			TRACED(TraceRestack, m->barwin, restack(m)); /* draws the bar as well */
+		else if (pending & PendDraw)
+			TRACED(TraceDrawbar, m->barwin, drawbar(m));
+		else if (pending & PendLazyDraw) {
+			if (msnow() - m->lastdraw >= 1000 / REFRESH(m))
+				TRACED(TraceDrawbar, m->barwin, drawbar(m));
+			else
+				m->pending |= PendLazyDraw; /* drawdue() tells run() when */
+		}
+	}
+	if (clientlistdirty)
+		updateclientlist();
+	ipcnotify();
+	batching = b;
 }
 
 void
@@ -878,14 +1430,14 @@ focusstack(const Arg *arg)
 }
 
 Atom
-getatomprop(Client *c, Atom prop)
+getatomprop(Window w, Atom prop)
 {
 	int di;
 	unsigned long dl;
 	unsigned char *p = NULL;
 	Atom da, atom = None;
 
-	if (XGetWindowProperty(dpy, c->win, prop, 0L, sizeof atom, False, XA_ATOM,
+	if (XGetWindowProperty(dpy, w, prop, 0L, sizeof atom, False, XA_ATOM,
 		&da, &di, &dl, &dl, &p) == Success && p) {
 		atom = *(Atom *)p;
 		XFree(p);
@@ -893,6 +1445,150 @@ getatomprop(Client *c, Atom prop)
 	return atom;
 }
 
+#ifdef XCB
+static int
+proptext(xcb_get_property_reply_t *r, char *text, unsigned int size)
+{
+	XTextProperty name;
+	int len;
+
+	text[0] = '\0';
+	if (!r || r->type == None || !r->format || !(len = xcb_get_property_value_length(r)))
+		return 0;
+	name.value = ecalloc(len + 1, 1);
+	memcpy(name.value, xcb_get_property_value(r), len);
+	name.encoding = r->type;
+	name.format = r->format;
+	name.nitems = len / (r->format / 8);
+	textpropcopy(&name, text, size);
+	free(name.value);
+	return 1;
+}
+
+static long
+propcard32(xcb_get_property_reply_t *r, Atom type, int i, long def)
+{
+	if (!r || r->type != type || r->format != 32
+	|| xcb_get_property_value_length(r) < 4 * (i + 1))
+		return def;
+	return ((uint32_t *)xcb_get_property_value(r))[i];
+}
+
+/* Sends the requests for all properties manage() reads before waiting for
+ * the first reply, one round trip instead of one per property. */
+void
+getmanageprops(Window w, ManageProps *p)
+{
+	enum { PropNetWMName, PropWMName, PropTrans, PropClass, PropState,
+	       PropType, PropNormalHints, PropHints, PropLast };
+	xcb_connection_t *xc = XGetXCBConnection(dpy);
+	xcb_get_property_cookie_t ck[PropLast];
+	xcb_get_property_reply_t *r[PropLast];
+	const char *v;
+	int i, len, n;
+
+	memset(p, 0, sizeof(ManageProps));
+	ck[PropNetWMName] = xcb_get_property(xc, 0, w, netatom[NetWMName], XCB_GET_PROPERTY_TYPE_ANY, 0, 256);
+	ck[PropWMName] = xcb_get_property(xc, 0, w, XA_WM_NAME, XCB_GET_PROPERTY_TYPE_ANY, 0, 256);
+	ck[PropTrans] = xcb_get_property(xc, 0, w, XA_WM_TRANSIENT_FOR, XA_WINDOW, 0, 1);
+	ck[PropClass] = xcb_get_property(xc, 0, w, XA_WM_CLASS, XA_STRING, 0, 128);
+	ck[PropState] = xcb_get_property(xc, 0, w, netatom[NetWMState], XA_ATOM, 0, 1);
+	ck[PropType] = xcb_get_property(xc, 0, w, netatom[NetWMWindowType], XA_ATOM, 0, 1);
+	ck[PropNormalHints] = xcb_get_property(xc, 0, w, XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, 0, 18);
+	ck[PropHints] = xcb_get_property(xc, 0, w, XA_WM_HINTS, XA_WM_HINTS, 0, 9);
+	for (i = 0; i < PropLast; i++)
+		r[i] = xcb_get_property_reply(xc, ck[i], NULL);
+
+	if (!proptext(r[PropNetWMName], p->name, sizeof p->name))
+		proptext(r[PropWMName], p->name, sizeof p->name);
+	p->trans = propcard32(r[PropTrans], XA_WINDOW, 0, None);
+	strcpy(p->class, broken);
+	strcpy(p->instance, broken);
+	if (r[PropClass] && r[PropClass]->type == XA_STRING && r[PropClass]->format == 8) {
+		v = xcb_get_property_value(r[PropClass]);
+		len = xcb_get_property_value_length(r[PropClass]);
+		for (n = 0; n < len && v[n]; n++);
+		snprintf(p->instance, sizeof p->instance, "%.*s", n, v);
+		snprintf(p->class, sizeof p->class, "%.*s",
+			n < len ? (int)strnlen(v + n + 1, len - n - 1) : 0, n < len ? v + n + 1 : "");
+	}
+	p->state = propcard32(r[PropState], XA_ATOM, 0, None);
+	p->wtype = propcard32(r[PropType], XA_ATOM, 0, None);
+
+	/* the same checks and layout XGetWMNormalHints() uses */
+	if (propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 14, -1) == -1)
+		p->size.flags = PSize;
+	else {
+		p->size.flags = propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 0, 0);
+		p->size.min_width = propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 5, 0);
+		p->size.min_height = propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 6, 0);
+		p->size.max_width = propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 7, 0);
+		p->size.max_height = propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 8, 0);
+		p->size.width_inc = propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 9, 0);
+		p->size.height_inc = propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 10, 0);
+		p->size.min_aspect.x = propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 11, 0);
+		p->size.min_aspect.y = propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 12, 0);
+		p->size.max_aspect.x = propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 13, 0);
+		p->size.max_aspect.y = propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 14, 0);
+		if (propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 17, -1) != -1) {
+			p->size.base_width = propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 15, 0);
+			p->size.base_height = propcard32(r[PropNormalHints], XA_WM_SIZE_HINTS, 16, 0);
+		} else
+			p->size.flags &= ~(PBaseSize|PWinGravity);
+	}
+	/* and XGetWMHints() */
+	if (propcard32(r[PropHints], XA_WM_HINTS, 7, -1) != -1) {
+		p->haswmh = 1;
+		p->wmh.flags = propcard32(r[PropHints], XA_WM_HINTS, 0, 0);
+		p->wmh.input = propcard32(r[PropHints], XA_WM_HINTS, 1, 0) ? True : False;
+		p->wmh.initial_state = propcard32(r[PropHints], XA_WM_HINTS, 2, 0);
+		p->wmh.icon_pixmap = propcard32(r[PropHints], XA_WM_HINTS, 3, 0);
+		p->wmh.icon_window = propcard32(r[PropHints], XA_WM_HINTS, 4, 0);
+		p->wmh.icon_x = propcard32(r[PropHints], XA_WM_HINTS, 5, 0);
+		p->wmh.icon_y = propcard32(r[PropHints], XA_WM_HINTS, 6, 0);
+		p->wmh.icon_mask = propcard32(r[PropHints], XA_WM_HINTS, 7, 0);
+		p->wmh.window_group = propcard32(r[PropHints], XA_WM_HINTS, 8, 0);
+	}
+	for (i = 0; i < PropLast; i++)
+		free(r[i]);
+	if (p->name[0] == '\0') /* hack to mark broken clients */
+		strcpy(p->name, broken);
+}
+#else
+void
+getmanageprops(Window w, ManageProps *p)
+{
+	XClassHint ch = { NULL, NULL };
+	XWMHints *wmh;
+	long msize;
+
+	memset(p, 0, sizeof(ManageProps));
+	if (!gettextprop(w, netatom[NetWMName], p->name, sizeof p->name))
+		gettextprop(w, XA_WM_NAME, p->name, sizeof p->name);
+	if (p->name[0] == '\0') /* hack to mark broken clients */
+		strcpy(p->name, broken);
+	if (!XGetTransientForHint(dpy, w, &p->trans))
+		p->trans = None;
+	XGetClassHint(dpy, w, &ch);
+	snprintf(p->class, sizeof p->class, "%s", ch.res_class ? ch.res_class : broken);
+	snprintf(p->instance, sizeof p->instance, "%s", ch.res_name ? ch.res_name : broken);
+	if (ch.res_class)
+		XFree(ch.res_class);
+	if (ch.res_name)
+		XFree(ch.res_name);
+	p->state = getatomprop(w, netatom[NetWMState]);
+	p->wtype = getatomprop(w, netatom[NetWMWindowType]);
+	if (!XGetWMNormalHints(dpy, w, &p->size, &msize))
+		/* size is uninitialized, ensure that size.flags aren't used */
+		p->size.flags = PSize;
+	if ((wmh = XGetWMHints(dpy, w))) {
+		p->wmh = *wmh;
+		p->haswmh = 1;
+		XFree(wmh);
+	}
+}
+#endif /* XCB */
+
 int
 getrootptr(int *x, int *y)
 {
@@ -903,6 +1599,7 @@ getrootptr(int *x, int *y)
 	return XQueryPointer(dpy, root, &dummy, &dummy, x, y, &di, &di, &dui);
 }
 
+#ifndef XCB
 long
 getstate(Window w)
 {
@@ -920,12 +1617,11 @@ getstate(Window w)
 	XFree(p);
 	return result;
 }
+#endif /* XCB */
 
 int
 gettextprop(Window w, Atom atom, char *text, unsigned int size)
 {
-	char **list = NULL;
-	int n;
 	XTextProperty name;
 
 	if (!text || size == 0)
@@ -933,15 +1629,7 @@ gettextprop(Window w, Atom atom, char *text, unsigned int size)
 	text[0] = '\0';
 	if (!XGetTextProperty(dpy, w, &name, atom) || !name.nitems)
 		return 0;
-	if (name.encoding == XA_STRING)
-		strncpy(text, (char *)name.value, size - 1);
-	else {
-		if (XmbTextPropertyToTextList(dpy, &name, &list, &n) >= Success && n > 0 && *list) {
-			strncpy(text, *list, size - 1);
-			XFreeStringList(list);
-		}
-	}
-	text[size - 1] = '\0';
+	textpropcopy(&name, text, size);
 	XFree(name.value);
 	return 1;
 }
@@ -949,40 +1637,45 @@ gettextprop(Window w, Atom atom, char *text, unsigned int size)
 void
 grabbuttons(Client *c, int focused)
 {
-	updatenumlockmask();
-	{
-		unsigned int i, j;
-		unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+	unsigned int i, j;
+	unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+	int state = focused ? GrabFocused : GrabUnfocused;
+
+	/* All grabs freeze the pointer and buttonpress() tells bindings from
+	 * clicks for the client, so the catch-all grab of an unfocused client
+	 * can stand in for the bindings and unfocusing only adds it. Removing
+	 * it removes the bindings as well, so focusing grabs those again. */
+	if (c->grabbed == state)
+		return;
+	if (focused || c->grabbed == GrabNone)
 		XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
-		if (!focused)
-			XGrabButton(dpy, AnyButton, AnyModifier, c->win, False,
-				BUTTONMASK, GrabModeSync, GrabModeSync, None, None);
+	if (!focused)
+		XGrabButton(dpy, AnyButton, AnyModifier, c->win, False,
+			BUTTONMASK, GrabModeSync, GrabModeSync, None, None);
+	else
 		for (i = 0; i < LENGTH(buttons); i++)
 			if (buttons[i].click == ClkClientWin)
-				for (j = 0; j < LENGTH(modifiers); j++)
+				for (j = 0; j < (numlockmask ? LENGTH(modifiers) : 2); j++)
 					XGrabButton(dpy, buttons[i].button,
 						buttons[i].mask | modifiers[j],
 						c->win, False, BUTTONMASK,
-						GrabModeAsync, GrabModeSync, None, None);
-	}
+						GrabModeSync, GrabModeSync, None, None);
+	c->grabbed = state;
 }
 
 void
 grabkeys(void)
 {
-	updatenumlockmask();
-	{
-		unsigned int i, j;
-		unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
-		KeyCode code;
+	unsigned int i, j;
+	unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+	KeyCode code;
 
-		XUngrabKey(dpy, AnyKey, AnyModifier, root);
-		for (i = 0; i < LENGTH(keys); i++)
-			if ((code = XKeysymToKeycode(dpy, keys[i].keysym)))
-				for (j = 0; j < LENGTH(modifiers); j++)
-					XGrabKey(dpy, code, keys[i].mod | modifiers[j], root,
-						True, GrabModeAsync, GrabModeAsync);
-	}
+	XUngrabKey(dpy, AnyKey, AnyModifier, root);
+	for (i = 0; i < LENGTH(keys); i++)
+		if ((code = XKeysymToKeycode(dpy, keys[i].keysym)))
+			for (j = 0; j < (numlockmask ? LENGTH(modifiers) : 2); j++)
+				XGrabKey(dpy, code, keys[i].mod | modifiers[j], root,
+					True, GrabModeAsync, GrabModeAsync);
 }
 
 void
@@ -992,73 +1685,395 @@ incnmaster(const Arg *arg)
 	arrange(selmon);
 }
 
-#ifdef XINERAMA
-static int
-isuniquegeom(XineramaScreenInfo *unique, size_t n, XineramaScreenInfo *info)
+void
+ipcaccept(void)
 {
-	while (n--)
-		if (unique[n].x_org == info->x_org && unique[n].y_org == info->y_org
-		&& unique[n].width == info->width && unique[n].height == info->height)
+	int fd;
+	size_t i;
+
+	if ((fd = accept(ipcfd, NULL, NULL)) < 0)
+		return;
+	for (i = 0; i < LENGTH(ipcconns) && ipcconns[i].fd >= 0; i++);
+	if (i == LENGTH(ipcconns)) {
+		close(fd);
+		return;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	ipcconns[i].fd = fd;
+	ipcconns[i].subscribed = 0;
+	ipcconns[i].len = 0;
+}
+
+/* Parses s into the Arg the function of an IpcCommand expects, which is the
+ * same one it gets from keys[]. */
+int
+ipcarg(int type, const char *s, Arg *a)
+{
+	char *end;
+	long l;
+
+	if (!*s) /* setlayout without a layout toggles, like in keys[] */
+		return type == IpcNone || type == IpcLayout;
+	switch (type) {
+	case IpcInt:
+		a->i = strtol(s, &end, 0);
+		break;
+	case IpcUint:
+		a->ui = strtoul(s, &end, 0);
+		break;
+	case IpcFloat:
+		a->f = strtof(s, &end);
+		break;
+	case IpcLayout:
+		if ((l = strtol(s, &end, 10)) < 0 || l >= LENGTH(layouts))
 			return 0;
-	return 1;
+		a->v = &layouts[l];
+		break;
+	default:
+		return 0;
+	}
+	return end != s && !*end;
 }
-#endif /* XINERAMA */
 
 void
-keypress(XEvent *e)
+ipcclose(IpcConn *cn)
 {
-	unsigned int i;
-	KeySym keysym;
-	XKeyEvent *ev;
-
-	ev = &e->xkey;
-	keysym = XKeycodeToKeysym(dpy, (KeyCode)ev->keycode, 0);
-	for (i = 0; i < LENGTH(keys); i++)
-		if (keysym == keys[i].keysym
-		&& CLEANMASK(keys[i].mod) == CLEANMASK(ev->state)
-		&& keys[i].func)
-			keys[i].func(&(keys[i].arg));
+	close(cn->fd);
+	cn->fd = -1;
+	cn->subscribed = 0;
 }
 
 void
-killclient(const Arg *arg)
+ipccommand(IpcConn *cn, char *line)
 {
-	if (!selmon->sel)
-		return;
-	if (!sendevent(selmon->sel, wmatom[WMDelete])) {
-		XGrabServer(dpy);
-		XSetErrorHandler(xerrordummy);
-		XSetCloseDownMode(dpy, DestroyAll);
-		XKillClient(dpy, selmon->sel->win);
-		XSync(dpy, False);
-		XSetErrorHandler(xerror);
-		XUngrabServer(dpy);
+	Arg a = {0};
+	char *arg, *end;
+	size_t i;
+	long seg = 0;
+
+	if ((arg = strchr(line, ' ')))
+		*arg++ = '\0';
+	else
+		arg = line + strlen(line);
+
+	if (!strcmp(line, "subscribe")) {
+		cn->subscribed = 1;
+		ipcresync = 1;
+		ipcsend(cn, "ok\n");
+	} else if (!strcmp(line, "status") || !strcmp(line, "segment")) {
+		/* status replaces all segments, segment only the given one */
+		if (!strcmp(line, "status"))
+			for (i = 0; i < IPCSEGMENTS; i++)
+				ipcseg[i][0] = '\0';
+		else if ((seg = strtol(arg, &end, 10)) < 0 || seg >= IPCSEGMENTS
+		|| end == arg || (*end && *end != ' ')) {
+			ipcsend(cn, "error: bad segment\n");
+			return;
+		} else
+			arg = *end ? end + 1 : end;
+		strncpy(ipcseg[seg], arg, sizeof ipcseg[seg] - 1);
+		for (stext[0] = '\0', i = 0; i < IPCSEGMENTS; i++) {
+			if (!ipcseg[i][0])
+				continue;
+			if (stext[0])
+				strncat(stext, ipcstatussep, sizeof stext - 1 - strlen(stext));
+			strncat(stext, ipcseg[i], sizeof stext - 1 - strlen(stext));
+		}
+		selmon->pending |= PendLazyDraw;
+		ipcsend(cn, "ok\n");
+#ifdef TRACE
+	} else if (!strcmp(line, "trace")) {
+		tracedump(cn, !strcmp(arg, "reset"));
+		ipcsend(cn, "ok\n");
+#endif /* TRACE */
+	} else {
+		for (i = 0; i < LENGTH(ipccommands) && strcmp(line, ipccommands[i].name); i++);
+		if (i == LENGTH(ipccommands))
+			ipcsend(cn, "error: unknown command %s\n", line);
+		else if (!ipcarg(ipccommands[i].argtype, arg, &a))
+			ipcsend(cn, "error: bad argument for %s\n", line);
+		else {
+			ipccommands[i].func(&a);
+			ipcsend(cn, "ok\n");
+		}
 	}
 }
 
-void
-manage(Window w, XWindowAttributes *wa)
+/* Fills fds with what poll() has to watch for ipc, returns how many. */
+int
+ipcfds(struct pollfd *fds)
 {
-	Client *c, *t = NULL;
-	Window trans = None;
-	XWindowChanges wc;
+	int n = 0;
+	size_t i;
 
-	c = ecalloc(1, sizeof(Client));
-	c->win = w;
-	/* geometry */
-	c->x = c->oldx = wa->x;
-	c->y = c->oldy = wa->y;
-	c->w = c->oldw = wa->width;
+	if (ipcfd < 0)
+		return 0;
+	fds[n].fd = ipcfd;
+	fds[n++].events = POLLIN;
+	for (i = 0; i < LENGTH(ipcconns); i++)
+		if (ipcconns[i].fd >= 0) {
+			fds[n].fd = ipcconns[i].fd;
+			fds[n++].events = POLLIN;
+		}
+	return n;
+}
+
+/* Tells subscribers which tags, layouts and focus changed since last time. */
+void
+ipcnotify(void)
+{
+	Client *c;
+	Monitor *m;
+	IpcState s;
+	Window win;
+	size_t i;
+	int resync = ipcresync;
+
+	for (i = 0; i < LENGTH(ipcconns) && !ipcconns[i].subscribed; i++);
+	if (i == LENGTH(ipcconns))
+		return;
+	ipcresync = 0;
+	for (m = mons; m; m = m->next) {
+		memset(&s, 0, sizeof s);
+		s.tagset = m->tagset[m->seltags];
+		for (c = m->clients; c; c = c->next) {
+			s.occ |= c->tags;
+			if (c->isurgent)
+				s.urg |= c->tags;
+		}
+		strcpy(s.ltsymbol, m->ltsymbol);
+		if (resync || s.tagset != m->sent.tagset || s.occ != m->sent.occ
+		|| s.urg != m->sent.urg)
+			ipcsend(NULL, "tags %d %u %u %u\n", m->num, s.tagset, s.occ, s.urg);
+		if (resync || strcmp(s.ltsymbol, m->sent.ltsymbol))
+			ipcsend(NULL, "layout %d %s\n", m->num, s.ltsymbol);
+		m->sent = s;
+	}
+	win = selmon->sel ? selmon->sel->win : None;
+	if (resync || win != ipcselwin || selmon->num != ipcselmon)
+		ipcsend(NULL, "focus %d 0x%lx\n", selmon->num, win);
+	ipcselwin = win;
+	ipcselmon = selmon->num;
+}
+
+/* Handles what poll() found on the fds ipcfds() returned. */
+void
+ipcread(struct pollfd *fds, int n)
+{
+	IpcConn *cn;
+	char *line, *nl;
+	ssize_t r;
+	size_t i;
+	int j;
+
+	for (j = 0; j < n; j++) {
+		if (!fds[j].revents)
+			continue;
+		if (fds[j].fd == ipcfd) {
+			ipcaccept();
+			continue;
+		}
+		/* the connection may have been dropped by an earlier ipcsend() */
+		for (i = 0; i < LENGTH(ipcconns) && ipcconns[i].fd != fds[j].fd; i++);
+		if (i == LENGTH(ipcconns))
+			continue;
+		cn = &ipcconns[i];
+		r = read(cn->fd, cn->buf + cn->len, sizeof cn->buf - 1 - cn->len);
+		if (r < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+		if (r <= 0) {
+			ipcclose(cn);
+			continue;
+		}
+		cn->len += r;
+		cn->buf[cn->len] = '\0';
+		for (line = cn->buf; cn->fd >= 0 && (nl = strchr(line, '\n')); line = nl + 1) {
+			*nl = '\0';
+			ipccommand(cn, line);
+		}
+		if (cn->fd < 0)
+			continue;
+		cn->len -= line - cn->buf;
+		memmove(cn->buf, line, cn->len);
+		if (cn->len == sizeof cn->buf - 1) /* line too long */
+			ipcclose(cn);
+	}
+}
+
+/* Sends a line to cn, or to all subscribers if cn is NULL. Whoever does not
+ * keep up with reading is dropped rather than blocking dwm. */
+void
+ipcsend(IpcConn *cn, const char *fmt, ...)
+{
+	char buf[512];
+	va_list ap;
+	size_t i;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof buf, fmt, ap);
+	va_end(ap);
+	len = MIN(len, (int)sizeof buf - 1);
+	for (i = 0; i < LENGTH(ipcconns); i++) {
+		if (ipcconns[i].fd < 0 || (cn ? cn != &ipcconns[i] : !ipcconns[i].subscribed))
+			continue;
+		if (send(ipcconns[i].fd, buf, len, MSG_NOSIGNAL) != len)
+			ipcclose(&ipcconns[i]);
+	}
+}
+
+/* The socket is $DWM_SOCKET if set, otherwise dwm-$DISPLAY.sock in
+ * $XDG_RUNTIME_DIR or, without one, in a private /tmp/dwm-$UID. */
+void
+ipcsetup(void)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct stat st;
+	const char *env, *d;
+	char dir[32], disp[64];
+	size_t i;
+	int fd, n;
+
+	for (i = 0; i < LENGTH(ipcconns); i++)
+		ipcconns[i].fd = -1;
+	if (!ipcsocket)
+		return;
+	if ((env = getenv("DWM_SOCKET")) && *env) {
+		n = snprintf(ipcpath, sizeof ipcpath, "%s", env);
+	} else {
+		for (i = 0, d = DisplayString(dpy); d[i] && i < sizeof disp - 1; i++)
+			disp[i] = d[i] == '/' ? '_' : d[i];
+		disp[i] = '\0';
+		if (!(env = getenv("XDG_RUNTIME_DIR")) || !*env) {
+			snprintf(dir, sizeof dir, "/tmp/dwm-%lu", (unsigned long)getuid());
+			if ((mkdir(dir, 0700) < 0 && errno != EEXIST) || lstat(dir, &st) < 0
+			|| !S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077)) {
+				fprintf(stderr, "dwm: ipc directory %s is not private, ipc disabled\n", dir);
+				return;
+			}
+			env = dir;
+		}
+		n = snprintf(ipcpath, sizeof ipcpath, "%s/dwm-%s.sock", env, disp);
+	}
+	if (n < 0 || (size_t)n >= sizeof ipcpath)
+		die("dwm: ipc socket path too long");
+	strcpy(addr.sun_path, ipcpath);
+	/* only a socket nobody answers on is stale and safe to replace */
+	if (lstat(ipcpath, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			fprintf(stderr, "dwm: %s is not a socket, ipc disabled\n", ipcpath);
+			return;
+		}
+		if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) >= 0) {
+			if (connect(fd, (struct sockaddr *)&addr, sizeof addr) == 0)
+				die("dwm: another dwm is listening on %s", ipcpath);
+			close(fd);
+		}
+		unlink(ipcpath);
+	}
+	if ((ipcfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+	|| bind(ipcfd, (struct sockaddr *)&addr, sizeof addr) < 0
+	|| listen(ipcfd, 8) < 0) {
+		fprintf(stderr, "dwm: ipc socket %s", ipcpath);
+		perror(" failed");
+		if (ipcfd >= 0)
+			close(ipcfd);
+		ipcfd = -1;
+		return;
+	}
+	fcntl(ipcfd, F_SETFD, FD_CLOEXEC);
+	/* a client gone before accept() must not block the event loop */
+	fcntl(ipcfd, F_SETFL, O_NONBLOCK);
+}
+
+#ifdef XINERAMA
+static int
+isuniquegeom(XineramaScreenInfo *unique, size_t n, XineramaScreenInfo *info)
+{
+	while (n--)
+		if (unique[n].x_org == info->x_org && unique[n].y_org == info->y_org
+		&& unique[n].width == info->width && unique[n].height == info->height)
+			return 0;
+	return 1;
+}
+#endif /* XINERAMA */
+
+void
+keypress(XEvent *e)
+{
+	unsigned int i;
+	KeySym keysym;
+	XKeyEvent *ev;
+
+	ev = &e->xkey;
+	keysym = XKeycodeToKeysym(dpy, (KeyCode)ev->keycode, 0);
+	for (i = 0; i < LENGTH(keys); i++)
+		if (keysym == keys[i].keysym
+		&& CLEANMASK(keys[i].mod) == CLEANMASK(ev->state)
+		&& keys[i].func)
+			keys[i].func(&(keys[i].arg));
+}
+
+void
+killclient(const Arg *arg)
+{
+	if (!selmon->sel)
+		return;
+	if (!sendevent(selmon->sel, wmatom[WMDelete])) {
+		XGrabServer(dpy);
+		XSetErrorHandler(xerrordummy);
+		XSetCloseDownMode(dpy, DestroyAll);
+		XKillClient(dpy, selmon->sel->win);
+		XSync(dpy, False);
+		XSetErrorHandler(xerror);
+		XUngrabServer(dpy);
+	}
+}
+
+/* Returns the rendered layout symbol, replacing the oldest one if it is new,
+ * as monocle's client count makes for more symbols than layouts. */
+Pixmap
+ltpixmap(const char *symbol, unsigned int w)
+{
+	LtPixmap *lp;
+	unsigned int i;
+
+	for (i = 0; i < LTCACHE_SIZ; i++)
+		if (ltpix[i].pix && !strcmp(ltpix[i].symbol, symbol))
+			return ltpix[i].pix;
+	lp = &ltpix[ltpixnext++ % LTCACHE_SIZ];
+	if (lp->pix)
+		XFreePixmap(dpy, lp->pix);
+	strncpy(lp->symbol, symbol, sizeof lp->symbol - 1);
+	lp->pix = barsegment(symbol, w, 0);
+	return lp->pix;
+}
+
+void
+manage(Window w, XWindowAttributes *wa)
+{
+	Client *c, *t = NULL;
+	ManageProps p;
+	XWindowChanges wc;
+
+	getmanageprops(w, &p);
+	c = ecalloc(1, sizeof(Client));
+	c->win = w;
+	/* geometry */
+	c->x = c->oldx = wa->x;
+	c->y = c->oldy = wa->y;
+	c->w = c->oldw = wa->width;
 	c->h = c->oldh = wa->height;
 	c->oldbw = wa->border_width;
 
-	updatetitle(c);
-	if (XGetTransientForHint(dpy, w, &trans) && (t = wintoclient(trans))) {
+	strcpy(c->name, p.name);
+	if ((t = wintoclient(p.trans))) {
 		c->mon = t->mon;
 		c->tags = t->tags;
 	} else {
 		c->mon = selmon;
-		applyrules(c);
+		applyrules(c, p.class, p.instance);
 	}
 
 	if (c->x + WIDTH(c) > c->mon->mx + c->mon->mw)
@@ -1075,26 +2090,30 @@ manage(Window w, XWindowAttributes *wa)
 	XConfigureWindow(dpy, w, CWBorderWidth, &wc);
 	XSetWindowBorder(dpy, w, scheme[SchemeNorm][ColBorder].pixel);
 	configure(c); /* propagates border_width, if size doesn't change */
-	updatewindowtype(c);
-	updatesizehints(c);
-	updatewmhints(c);
-	XSelectInput(dpy, w, EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask);
+	setwindowtype(c, p.state, p.wtype);
+	setsizehints(c, &p.size);
+	if (p.haswmh)
+		setwmhints(c, &p.wmh);
+	XSelectInput(dpy, w, CLIENTMASK);
 	grabbuttons(c, 0);
 	if (!c->isfloating)
-		c->isfloating = c->oldstate = trans != None || c->isfixed;
-	if (c->isfloating)
+		c->isfloating = c->oldstate = p.trans != None || c->isfixed;
+	if (c->isfloating) {
 		XRaiseWindow(dpy, c->win);
+		c->stackedbelow = None;
+	}
 	attach(c);
 	attachstack(c);
-	XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32, PropModeAppend,
-		(unsigned char *) &(c->win), 1);
 	XMoveResizeWindow(dpy, c->win, c->x + 2 * sw, c->y, c->w, c->h); /* some windows require this */
+	c->offscreen = 1;
 	setclientstate(c, NormalState);
 	if (c->mon == selmon)
 		unfocus(selmon->sel, 0);
 	c->mon->sel = c;
 	arrange(c->mon);
-	XMapWindow(dpy, c->win);
+	/* with batching arrange() has not run showhide() yet, ishidden is stale */
+	if (!hideunmap || ISVISIBLE(c))
+		XMapWindow(dpy, c->win);
 	focus(NULL);
 }
 
@@ -1105,7 +2124,9 @@ managealtbar(Window win, XWindowAttributes *wa)
 	if (!(m = recttomon(wa->x, wa->y, wa->width, wa->height)))
 		return;
 
+	winindexdel(m->barwin);
 	m->barwin = win;
+	winindexput(win, NULL, m);
 	m->by = wa->y;
 	bh = m->bh = wa->height;
 	updatebarpos(m);
@@ -1113,8 +2134,7 @@ managealtbar(Window win, XWindowAttributes *wa)
 	XSelectInput(dpy, win, EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask);
 	XMoveResizeWindow(dpy, win, wa->x, wa->y, wa->width, wa->height);
 	XMapWindow(dpy, win);
-	XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32, PropModeAppend,
-		(unsigned char *) &win, 1);
+	clientlistdirty = 1;
 }
 
 void
@@ -1124,7 +2144,9 @@ managetray(Window win, XWindowAttributes *wa)
 	if (!(m = recttomon(wa->x, wa->y, wa->width, wa->height)))
 		return;
 
+	winindexdel(m->traywin);
 	m->traywin = win;
+	winindexput(win, NULL, m);
 	m->tx = wa->x;
 	m->tw = wa->width;
 	updatebarpos(m);
@@ -1132,26 +2154,50 @@ managetray(Window win, XWindowAttributes *wa)
 	XSelectInput(dpy, win, EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask);
 	XMoveResizeWindow(dpy, win, wa->x, wa->y, wa->width, wa->height);
 	XMapWindow(dpy, win);
-	XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32, PropModeAppend,
-			(unsigned char *) &win, 1);
+	clientlistdirty = 1;
 }
 
 
 void
 mappingnotify(XEvent *e)
 {
+	Client *c;
+	Monitor *m;
 	XMappingEvent *ev = &e->xmapping;
+	unsigned int oldmask = numlockmask;
 
 	XRefreshKeyboardMapping(ev);
-	if (ev->request == MappingKeyboard)
+	if (ev->request != MappingKeyboard && ev->request != MappingModifier)
+		return;
+	/* the only place the numlock modifier can change */
+	updatenumlockmask();
+	if (ev->request == MappingKeyboard || numlockmask != oldmask)
 		grabkeys();
+	if (numlockmask != oldmask)
+		for (m = mons; m; m = m->next)
+			for (c = m->clients; c; c = c->next) {
+				c->grabbed = GrabNone;
+				grabbuttons(c, c == selmon->sel);
+			}
 }
 
 void
 maprequest(XEvent *e)
 {
-	static XWindowAttributes wa;
 	XMapRequestEvent *ev = &e->xmaprequest;
+#ifdef XCB
+	WinInfo wi = { .win = ev->window };
+
+	wininfofetch(&wi);
+	wininforeply(&wi);
+	if (!wi.ok || wi.wa.override_redirect)
+		return;
+	if (wininfoclasscontains(&wi, altbarclass, ""))
+		managealtbar(ev->window, &wi.wa);
+	else if (!wintoclient(ev->window))
+		TRACED(TraceManage, ev->window, manage(ev->window, &wi.wa));
+#else
+	static XWindowAttributes wa;
 
 	if (!XGetWindowAttributes(dpy, ev->window, &wa))
 		return;
@@ -1160,7 +2206,8 @@ maprequest(XEvent *e)
 	if (wmclasscontains(ev->window, altbarclass, ""))
 		managealtbar(ev->window, &wa);
 	else if (!wintoclient(ev->window))
-		manage(ev->window, &wa);
+		TRACED(TraceManage, ev->window, manage(ev->window, &wa));
+#endif /* XCB */
 }
 
 void
@@ -1198,17 +2245,18 @@ motionnotify(XEvent *e)
 void
 movemouse(const Arg *arg)
 {
-	int x, y, ocx, ocy, nx, ny;
+	int x, y, ocx, ocy, nx, ny, px = 0, py = 0, moved = 0;
+	long last = 0;
 	Client *c;
 	Monitor *m;
 	XEvent ev;
-	Time lasttime = 0;
 
 	if (!(c = selmon->sel))
 		return;
 	if (c->isfullscreen) /* no support moving fullscreen windows by mouse */
 		return;
 	restack(selmon);
+	flushpending();
 	ocx = c->x;
 	ocy = c->y;
 	if (XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync,
@@ -1217,7 +2265,8 @@ movemouse(const Arg *arg)
 	if (!getrootptr(&x, &y))
 		return;
 	do {
-		XMaskEvent(dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev);
+		/* a pending position is shown once per refresh */
+		dragevent(&ev, moved ? dragdue(last) : -1);
 		switch(ev.type) {
 		case ConfigureRequest:
 		case Expose:
@@ -1225,12 +2274,17 @@ movemouse(const Arg *arg)
 			handler[ev.type](&ev);
 			break;
 		case MotionNotify:
-			if ((ev.xmotion.time - lasttime) <= (1000 / 60))
-				continue;
-			lasttime = ev.xmotion.time;
-
-			nx = ocx + (ev.xmotion.x - x);
-			ny = ocy + (ev.xmotion.y - y);
+			dragmotion(&ev);
+			px = ev.xmotion.x;
+			py = ev.xmotion.y;
+			moved = 1;
+			break;
+		}
+		if (moved && (ev.type == ButtonRelease || !dragdue(last))) {
+			moved = 0;
+			last = msnow();
+			nx = ocx + (px - x);
+			ny = ocy + (py - y);
 			if (abs(selmon->wx - nx) < snap)
 				nx = selmon->wx;
 			else if (abs((selmon->wx + selmon->ww) - (nx + WIDTH(c))) < snap)
@@ -1244,8 +2298,8 @@ movemouse(const Arg *arg)
 				togglefloating(NULL);
 			if (!selmon->lt[selmon->sellt]->arrange || c->isfloating)
 				resize(c, nx, ny, c->w, c->h, 1);
-			break;
 		}
+		flushpending(); /* this is an event loop of its own */
 	} while (ev.type != ButtonRelease);
 	XUngrabPointer(dpy, CurrentTime);
 	if ((m = recttomon(c->x, c->y, c->w, c->h)) != selmon) {
@@ -1255,6 +2309,15 @@ movemouse(const Arg *arg)
 	}
 }
 
+long
+msnow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 Client *
 nexttiled(Client *c)
 {
@@ -1279,7 +2342,7 @@ propertynotify(XEvent *e)
 	XPropertyEvent *ev = &e->xproperty;
 
 	if ((ev->window == root) && (ev->atom == XA_WM_NAME))
-		updatestatus();
+		statuspending = 1;
 	else if (ev->state == PropertyDelete)
 		return; /* ignore */
 	else if ((c = wintoclient(ev->window))) {
@@ -1298,22 +2361,170 @@ propertynotify(XEvent *e)
 			drawbars();
 			break;
 		}
-		if (ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName]) {
-			updatetitle(c);
-			if (c == c->mon->sel)
-				drawbar(c->mon);
-		}
+		if (ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName])
+			c->titlepending = titlespending = 1;
 		if (ev->atom == netatom[NetWMWindowType])
 			updatewindowtype(c);
 	}
 }
 
+/* Sets prop on the root window to the n windows in wins, unless that is what
+ * it was set to last time. Takes ownership of wins. */
+void
+publishlist(Atom prop, Window *wins, size_t n, Window **last, size_t *lastn)
+{
+	if (*last && n == *lastn && !memcmp(wins, *last, n * sizeof(Window))) {
+		free(wins);
+		return;
+	}
+	XChangeProperty(dpy, root, prop, XA_WINDOW, 32, PropModeReplace,
+		(unsigned char *) wins, n);
+	free(*last);
+	*last = wins;
+	*lastn = n;
+}
+
 void
 quit(const Arg *arg)
 {
 	running = 0;
 }
 
+#ifdef XRANDR
+/* Shows s on m, returning whether the geometry of m changed. */
+static int
+randrapply(Monitor *m, RRScreen *s)
+{
+	s->used = 1;
+	m->output = s->output;
+	m->refresh = s->refresh;
+	if (m->mx == s->x && m->my == s->y && m->mw == s->w && m->mh == s->h)
+		return 0;
+	m->mx = m->wx = s->x;
+	m->my = m->wy = s->y;
+	m->mw = m->ww = s->w;
+	m->mh = m->wh = s->h;
+	updatebarpos(m);
+	m->resized = 1;
+	return 1;
+}
+
+/* Matches the monitors to the active outputs by output, so that only those
+ * which were added, removed or changed are touched. Returns 0 if XRandR
+ * cannot tell, leaving the monitors to Xinerama. */
+static int
+randrgeom(int *dirty)
+{
+	int i, j, n = 0;
+	unsigned int v;
+	Client *c;
+	Monitor *m, *next, *t;
+	RRScreen *scr;
+	XRRCrtcInfo *ci;
+	XRRModeInfo *mi;
+	XRRScreenResources *res;
+
+	/* the current resources are what the server knows, without probing */
+	if (rrevbase < 0 || !(res = XRRGetScreenResourcesCurrent(dpy, root)))
+		return 0;
+	scr = ecalloc(MAX(res->ncrtc, 1), sizeof(RRScreen));
+	for (i = 0; i < res->ncrtc; i++) {
+		if (!(ci = XRRGetCrtcInfo(dpy, res, res->crtcs[i])))
+			continue;
+		/* mirrored outputs share a monitor */
+		for (j = 0; j < n; j++)
+			if (scr[j].x == ci->x && scr[j].y == ci->y
+			&& scr[j].w == (int)ci->width && scr[j].h == (int)ci->height)
+				break;
+		if (ci->mode != None && ci->noutput > 0 && j == n) {
+			scr[n].output = ci->outputs[0];
+			scr[n].x = ci->x;
+			scr[n].y = ci->y;
+			scr[n].w = ci->width;
+			scr[n].h = ci->height;
+			for (j = 0; j < res->nmode; j++) {
+				mi = &res->modes[j];
+				if (mi->id != ci->mode)
+					continue;
+				v = mi->vTotal;
+				if (mi->modeFlags & RR_DoubleScan)
+					v *= 2;
+				if (mi->modeFlags & RR_Interlace)
+					v /= 2;
+				if (mi->hTotal && v)
+					scr[n].refresh = (mi->dotClock + (unsigned long)mi->hTotal * v / 2)
+					                 / ((unsigned long)mi->hTotal * v);
+				break;
+			}
+			n++;
+		}
+		XRRFreeCrtcInfo(ci);
+	}
+	XRRFreeScreenResources(res);
+	if (!n) {
+		free(scr);
+		return 0;
+	}
+	/* monitors keep their output while it is there */
+	for (m = mons; m; m = m->next) {
+		for (i = 0; i < n && (scr[i].used || scr[i].output != m->output); i++);
+		if (i < n)
+			*dirty |= randrapply(m, &scr[i]);
+		else
+			m->output = None;
+	}
+	/* those which lost it take over a new one, */
+	for (m = mons; m; m = m->next)
+		if (m->output == None) {
+			for (i = 0; i < n && scr[i].used; i++);
+			if (i < n)
+				*dirty |= randrapply(m, &scr[i]);
+		}
+	/* the remaining new ones get a new monitor */
+	for (i = 0; i < n; i++)
+		if (!scr[i].used) {
+			for (m = mons; m && m->next; m = m->next);
+			if (m)
+				m = m->next = createmon();
+			else
+				m = mons = createmon();
+			*dirty |= randrapply(m, &scr[i]);
+		}
+	free(scr);
+	/* and monitors left without output hand their clients to the first */
+	for (t = mons; t->output == None; t = t->next);
+	for (m = mons; m; m = next) {
+		next = m->next;
+		if (m->output != None)
+			continue;
+		while ((c = m->clients)) {
+			m->clients = c->next;
+			detachstack(c);
+			c->mon = t;
+			attach(c);
+			attachstack(c);
+			t->resized = 1;
+		}
+		if (m == selmon)
+			selmon = t;
+		cleanupmon(m);
+		*dirty = 1;
+	}
+	for (i = 0, m = mons; m; m = m->next, i++)
+		m->num = i;
+	return 1;
+}
+
+/* Output changes come in bursts; they are looked at once the batch is
+ * handled, see updatemons(). */
+static void
+randrnotify(XEvent *e)
+{
+	XRRUpdateConfiguration(e);
+	geompending = 1;
+}
+#endif /* XRANDR */
+
 Monitor *
 recttomon(int x, int y, int w, int h)
 {
@@ -1346,32 +2557,38 @@ resizeclient(Client *c, int x, int y, int w, int h)
 	c->oldh = c->h; c->h = wc.height = h;
 	wc.border_width = c->bw;
 	XConfigureWindow(dpy, c->win, CWX|CWY|CWWidth|CWHeight|CWBorderWidth, &wc);
+	c->offscreen = 0;
 	configure(c);
-	XSync(dpy, False);
 }
 
 void
 resizemouse(const Arg *arg)
 {
-	int ocx, ocy, nw, nh;
+	int ocx, ocy, nx, ny, nw, nh, px = 0, py = 0, moved = 0;
+	long last = 0;
 	Client *c;
 	Monitor *m;
 	XEvent ev;
-	Time lasttime = 0;
 
 	if (!(c = selmon->sel))
 		return;
 	if (c->isfullscreen) /* no support resizing fullscreen windows by mouse */
 		return;
 	restack(selmon);
+	flushpending();
 	ocx = c->x;
 	ocy = c->y;
 	if (XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync,
 		None, cursor[CurResize]->cursor, CurrentTime) != GrabSuccess)
 		return;
 	XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w + c->bw - 1, c->h + c->bw - 1);
+#ifdef XSYNC
+	syncstart(c);
+#endif /* XSYNC */
 	do {
-		XMaskEvent(dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev);
+		/* a pending size is shown once per refresh, and once the client
+		 * drew the last one */
+		dragevent(&ev, moved ? dragdue(last) : -1);
 		switch(ev.type) {
 		case ConfigureRequest:
 		case Expose:
@@ -1379,12 +2596,28 @@ resizemouse(const Arg *arg)
 			handler[ev.type](&ev);
 			break;
 		case MotionNotify:
-			if ((ev.xmotion.time - lasttime) <= (1000 / 60))
-				continue;
-			lasttime = ev.xmotion.time;
-
-			nw = MAX(ev.xmotion.x - ocx - 2 * c->bw + 1, 1);
-			nh = MAX(ev.xmotion.y - ocy - 2 * c->bw + 1, 1);
+			dragmotion(&ev);
+			px = ev.xmotion.x;
+			py = ev.xmotion.y;
+			moved = 1;
+			break;
+#ifdef XSYNC
+		default:
+			/* the alarm also reports values from before the last
+			 * request, e.g. right after it was created */
+			if (syncevbase >= 0 && ev.type == syncevbase + XSyncAlarmNotify
+			&& ((XSyncAlarmNotifyEvent *)&ev)->alarm == dragsync.alarm
+			&& XSyncValueGreaterOrEqual(((XSyncAlarmNotifyEvent *)&ev)->counter_value,
+			dragsync.value))
+				dragsync.waiting = 0;
+			break;
+#endif /* XSYNC */
+		}
+		if (moved && (ev.type == ButtonRelease || !dragdue(last))) {
+			moved = 0;
+			last = msnow();
+			nw = MAX(px - ocx - 2 * c->bw + 1, 1);
+			nh = MAX(py - ocy - 2 * c->bw + 1, 1);
 			if (c->mon->wx + nw >= selmon->wx && c->mon->wx + nw <= selmon->wx + selmon->ww
 			&& c->mon->wy + nh >= selmon->wy && c->mon->wy + nh <= selmon->wy + selmon->wh)
 			{
@@ -1392,11 +2625,21 @@ resizemouse(const Arg *arg)
 				&& (abs(nw - c->w) > snap || abs(nh - c->h) > snap))
 					togglefloating(NULL);
 			}
-			if (!selmon->lt[selmon->sellt]->arrange || c->isfloating)
-				resize(c, c->x, c->y, nw, nh, 1);
-			break;
+			nx = c->x;
+			ny = c->y;
+			if ((!selmon->lt[selmon->sellt]->arrange || c->isfloating)
+			&& applysizehints(c, &nx, &ny, &nw, &nh, 1)) {
+#ifdef XSYNC
+				syncrequest(c);
+#endif /* XSYNC */
+				resizeclient(c, nx, ny, nw, nh);
+			}
 		}
+		flushpending(); /* this is an event loop of its own */
 	} while (ev.type != ButtonRelease);
+#ifdef XSYNC
+	syncstop();
+#endif /* XSYNC */
 	XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w + c->bw - 1, c->h + c->bw - 1);
 	XUngrabPointer(dpy, CurrentTime);
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
@@ -1413,21 +2656,39 @@ restack(Monitor *m)
 	Client *c;
 	XEvent ev;
 	XWindowChanges wc;
+	Window sibling = m->barwin;
+	int changed = 0;
 
+	if (batching) {
+		m->pending |= PendRestack;
+		return;
+	}
 	drawbar(m);
 	if (!m->sel)
 		return;
-	if (m->sel->isfloating || !m->lt[m->sellt]->arrange)
+	if (m->sel->isfloating || !m->lt[m->sellt]->arrange) {
 		XRaiseWindow(dpy, m->sel->win);
-	if (m->lt[m->sellt]->arrange) {
-		wc.stack_mode = Below;
-		wc.sibling = m->barwin;
-		for (c = m->stack; c; c = c->snext)
-			if (!c->isfloating && ISVISIBLE(c)) {
-				XConfigureWindow(dpy, c->win, CWSibling|CWStackMode, &wc);
-				wc.sibling = c->win;
-			}
+		changed = 1;
+	}
+	/* Tiled clients are stacked each below the one before, so only those
+	 * whose predecessor changed have to move. Raising a client leaves
+	 * its recorded place stale, so floating ones keep none. */
+	wc.stack_mode = Below;
+	for (c = m->stack; c; c = c->snext) {
+		if (!m->lt[m->sellt]->arrange || c->isfloating || !ISVISIBLE(c)) {
+			c->stackedbelow = None;
+			continue;
+		}
+		if (c->stackedbelow != sibling) {
+			wc.sibling = sibling;
+			XConfigureWindow(dpy, c->win, CWSibling|CWStackMode, &wc);
+			c->stackedbelow = sibling;
+			changed = 1;
+		}
+		sibling = c->win;
 	}
+	if (!changed)
+		return;
 	XSync(dpy, False);
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
 }
@@ -1435,12 +2696,42 @@ restack(Monitor *m)
 void
 run(void)
 {
+	int n;
 	XEvent ev;
+	struct pollfd fds[2 + IPCMAXCONNS];
+
 	/* main event loop */
 	XSync(dpy, False);
-	while (running && !XNextEvent(dpy, &ev))
-		if (handler[ev.type])
-			handler[ev.type](&ev); /* call handler */
+	fds[0].fd = ConnectionNumber(dpy);
+	fds[0].events = POLLIN;
+	while (running) {
+#ifdef TRACE
+		if (tracesig) {
+			tracesig = 0;
+			tracedump(NULL, 0);
+		}
+#endif /* TRACE */
+		batching = 1;
+		/* when idle, wait for X, an ipc client or a throttled redraw */
+		if (!XPending(dpy)) {
+			n = 1 + ipcfds(fds + 1);
+			if (poll(fds, n, drawdue()) > 0)
+				ipcread(fds + 1, n - 1);
+		}
+		/* handle everything already queued, then arrange and redraw once */
+		for (n = 0; running && n < 256 && XPending(dpy); n++) {
+			XNextEvent(dpy, &ev);
+#ifdef XRANDR
+			if (rrevbase >= 0 && ev.type >= rrevbase && ev.type <= rrevbase + RRNotify)
+				randrnotify(&ev);
+			else
+#endif /* XRANDR */
+			if (ev.type < LASTEvent && handler[ev.type])
+				TRACED(ev.type, ev.xany.window, handler[ev.type](&ev));
+		}
+		flushpending();
+		batching = 0;
+	}
 }
 
 void
@@ -1449,6 +2740,68 @@ runAutostart(void) {
 	system("cd ~/.dwm; ./autostart.sh &");
 }
 
+#ifdef XCB
+/* Fetches what scan() and scantray() need to know about every child of the
+ * root window. All requests are sent before the first reply is waited for,
+ * instead of paying a round trip for each of them. */
+static WinInfo *
+scanwins(unsigned int *num)
+{
+	xcb_connection_t *xc = XGetXCBConnection(dpy);
+	xcb_query_tree_reply_t *tree;
+	xcb_window_t *children;
+	WinInfo *wi;
+	unsigned int i;
+
+	*num = 0;
+	if (!(tree = xcb_query_tree_reply(xc, xcb_query_tree(xc, root), NULL)))
+		return NULL;
+	*num = xcb_query_tree_children_length(tree);
+	children = xcb_query_tree_children(tree);
+	wi = ecalloc(*num ? *num : 1, sizeof(WinInfo));
+	for (i = 0; i < *num; i++) {
+		wi[i].win = children[i];
+		wininfofetch(&wi[i]);
+	}
+	free(tree);
+	for (i = 0; i < *num; i++)
+		wininforeply(&wi[i]);
+	return wi;
+}
+
+void
+scan(void)
+{
+	unsigned int i, num;
+	WinInfo *wins = scanwins(&num);
+
+	for (i = 0; i < num; i++) {
+		if (!wins[i].ok || wins[i].wa.override_redirect || wins[i].transient)
+			continue;
+		if (wininfoclasscontains(&wins[i], altbarclass, ""))
+			managealtbar(wins[i].win, &wins[i].wa);
+		else if (wins[i].wa.map_state == IsViewable || wins[i].state == IconicState)
+			TRACED(TraceManage, wins[i].win, manage(wins[i].win, &wins[i].wa));
+	}
+	for (i = 0; i < num; i++) /* now the transients */
+		if (wins[i].ok && wins[i].transient
+		&& (wins[i].wa.map_state == IsViewable || wins[i].state == IconicState))
+			TRACED(TraceManage, wins[i].win, manage(wins[i].win, &wins[i].wa));
+	free(wins);
+}
+
+void
+scantray(void)
+{
+	unsigned int i, num;
+	WinInfo *wins = scanwins(&num);
+
+	for (i = 0; i < num; i++)
+		if (wins[i].ok && wininfoclasscontains(&wins[i], altbarclass, alttrayname))
+			managetray(wins[i].win, &wins[i].wa);
+	free(wins);
+}
+#else
 void
 scan(void)
 {
@@ -1464,14 +2817,14 @@ scan(void)
 			if (wmclasscontains(wins[i], altbarclass, ""))
 				managealtbar(wins[i], &wa);
 			else if (wa.map_state == IsViewable || getstate(wins[i]) == IconicState)
-				manage(wins[i], &wa);
+				TRACED(TraceManage, wins[i], manage(wins[i], &wa));
 		}
 		for (i = 0; i < num; i++) { /* now the transients */
 			if (!XGetWindowAttributes(dpy, wins[i], &wa))
 				continue;
 			if (XGetTransientForHint(dpy, wins[i], &d1)
 			&& (wa.map_state == IsViewable || getstate(wins[i]) == IconicState))
-				manage(wins[i], &wa);
+				TRACED(TraceManage, wins[i], manage(wins[i], &wa));
 		}
 		if (wins)
 			XFree(wins);
@@ -1498,8 +2851,7 @@ scantray(void)
 	if (wins)
 		XFree(wins);
 }
-
-
+#endif /* XCB */
 
 void
 sendmon(Client *c, Monitor *m)
@@ -1567,19 +2919,18 @@ void
 setfullscreen(Client *c, int fullscreen)
 {
 	if (fullscreen && !c->isfullscreen) {
-		XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
-			PropModeReplace, (unsigned char*)&netatom[NetWMFullscreen], 1);
 		c->isfullscreen = 1;
+		setnetstate(c);
 		c->oldstate = c->isfloating;
 		c->oldbw = c->bw;
 		c->bw = 0;
 		c->isfloating = 1;
 		resizeclient(c, c->mon->mx, c->mon->my, c->mon->mw, c->mon->mh);
 		XRaiseWindow(dpy, c->win);
+		c->stackedbelow = None;
 	} else if (!fullscreen && c->isfullscreen){
-		XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
-			PropModeReplace, (unsigned char*)0, 0);
 		c->isfullscreen = 0;
+		setnetstate(c);
 		c->isfloating = c->oldstate;
 		c->bw = c->oldbw;
 		c->x = c->oldx;
@@ -1591,6 +2942,29 @@ setfullscreen(Client *c, int fullscreen)
 	}
 }
 
+/* Lets c know whether it is on a hidden tag, so it can stop rendering. */
+void
+sethidden(Client *c, int hidden)
+{
+	c->ishidden = hidden;
+	setclientstate(c, hidden ? IconicState : NormalState);
+	setnetstate(c);
+	if (!hideunmap)
+		return;
+	if (!hidden) {
+		XMapWindow(dpy, c->win);
+		return;
+	}
+	/* keep unmapnotify from taking this for the client withdrawing */
+	XGrabServer(dpy);
+	XSelectInput(dpy, root, ROOTMASK & ~SubstructureNotifyMask);
+	XSelectInput(dpy, c->win, CLIENTMASK & ~StructureNotifyMask);
+	XUnmapWindow(dpy, c->win);
+	XSelectInput(dpy, c->win, CLIENTMASK);
+	XSelectInput(dpy, root, ROOTMASK);
+	XUngrabServer(dpy);
+}
+
 void
 setlayout(const Arg *arg)
 {
@@ -1620,15 +2994,76 @@ setmfact(const Arg *arg)
 	arrange(selmon);
 }
 
+void
+setnetstate(Client *c)
+{
+	Atom state[2];
+	int n = 0;
+
+	if (c->isfullscreen)
+		state[n++] = netatom[NetWMFullscreen];
+	if (c->ishidden)
+		state[n++] = netatom[NetWMHidden];
+	XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
+		PropModeReplace, (unsigned char *)state, n);
+}
+
+void
+setsizehints(Client *c, XSizeHints *hints)
+{
+	XSizeHints size = *hints;
+
+	if (size.flags & PBaseSize) {
+		c->basew = size.base_width;
+		c->baseh = size.base_height;
+	} else if (size.flags & PMinSize) {
+		c->basew = size.min_width;
+		c->baseh = size.min_height;
+	} else
+		c->basew = c->baseh = 0;
+	if (size.flags & PResizeInc) {
+		c->incw = size.width_inc;
+		c->inch = size.height_inc;
+	} else
+		c->incw = c->inch = 0;
+	if (size.flags & PMaxSize) {
+		c->maxw = size.max_width;
+		c->maxh = size.max_height;
+	} else
+		c->maxw = c->maxh = 0;
+	if (size.flags & PMinSize) {
+		c->minw = size.min_width;
+		c->minh = size.min_height;
+	} else if (size.flags & PBaseSize) {
+		c->minw = size.base_width;
+		c->minh = size.base_height;
+	} else
+		c->minw = c->minh = 0;
+	if (size.flags & PAspect) {
+		c->mina = (float)size.min_aspect.y / size.min_aspect.x;
+		c->maxa = (float)size.max_aspect.x / size.max_aspect.y;
+	} else
+		c->maxa = c->mina = 0.0;
+	c->isfixed = (c->maxw && c->maxh && c->maxw == c->minw && c->maxh == c->minh);
+}
+
 void
 setup(void)
 {
 	int i;
+#ifdef XSYNC
+	int major, minor;
+#endif /* XSYNC */
 	XSetWindowAttributes wa;
 	Atom utf8string;
+	Monitor *m;
 
 	/* clean up any zombies immediately */
 	sigchld(0);
+#ifdef TRACE
+	if (signal(SIGUSR1, sigtrace) == SIG_ERR)
+		die("can't install SIGUSR1 handler:");
+#endif /* TRACE */
 
 	/* init screen */
 	screen = DefaultScreen(dpy);
@@ -1640,6 +3075,18 @@ setup(void)
 		die("no fonts could be loaded.");
 	lrpad = drw->fonts->h;
 	bh = usealtbar ? 0 : drw->fonts->h + 2;
+#ifdef XRANDR
+	if (XRRQueryExtension(dpy, &rrevbase, &i))
+		XRRSelectInput(dpy, root, RRScreenChangeNotifyMask
+			| RRCrtcChangeNotifyMask | RROutputChangeNotifyMask);
+	else
+		rrevbase = -1;
+#endif /* XRANDR */
+#ifdef XSYNC
+	if (!XSyncQueryExtension(dpy, &syncevbase, &syncerrbase)
+	|| !XSyncInitialize(dpy, &major, &minor))
+		syncevbase = syncerrbase = -1;
+#endif /* XSYNC */
 	updategeom();
 	/* init atoms */
 	utf8string = XInternAtom(dpy, "UTF8_STRING", False);
@@ -1653,9 +3100,15 @@ setup(void)
 	netatom[NetWMState] = XInternAtom(dpy, "_NET_WM_STATE", False);
 	netatom[NetWMCheck] = XInternAtom(dpy, "_NET_SUPPORTING_WM_CHECK", False);
 	netatom[NetWMFullscreen] = XInternAtom(dpy, "_NET_WM_STATE_FULLSCREEN", False);
+	netatom[NetWMHidden] = XInternAtom(dpy, "_NET_WM_STATE_HIDDEN", False);
 	netatom[NetWMWindowType] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE", False);
 	netatom[NetWMWindowTypeDialog] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
 	netatom[NetClientList] = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
+	netatom[NetClientListStacking] = XInternAtom(dpy, "_NET_CLIENT_LIST_STACKING", False);
+#ifdef XSYNC
+	netatom[NetWMSyncRequest] = XInternAtom(dpy, "_NET_WM_SYNC_REQUEST", False);
+	netatom[NetWMSyncRequestCounter] = XInternAtom(dpy, "_NET_WM_SYNC_REQUEST_COUNTER", False);
+#endif /* XSYNC */
 	/* init cursors */
 	cursor[CurNormal] = drw_cur_create(drw, XC_left_ptr);
 	cursor[CurResize] = drw_cur_create(drw, XC_sizing);
@@ -1666,6 +3119,10 @@ setup(void)
 		scheme[i] = drw_scm_create(drw, colors[i], 3);
 	/* init bars */
 	updatebars();
+	/* the bars start out with the initial geometry, nothing is left to
+	 * apply for updatemons() */
+	for (m = mons; m; m = m->next)
+		m->resized = 0;
 	updatestatus();
 	/* supporting window for NetWMCheck */
 	wmcheckwin = XCreateSimpleWindow(dpy, root, 0, 0, 1, 1, 0, 0, 0);
@@ -1679,15 +3136,16 @@ setup(void)
 	XChangeProperty(dpy, root, netatom[NetSupported], XA_ATOM, 32,
 		PropModeReplace, (unsigned char *) netatom, NetLast);
 	XDeleteProperty(dpy, root, netatom[NetClientList]);
+	XDeleteProperty(dpy, root, netatom[NetClientListStacking]);
 	/* select events */
 	wa.cursor = cursor[CurNormal]->cursor;
-	wa.event_mask = SubstructureRedirectMask|SubstructureNotifyMask
-		|ButtonPressMask|PointerMotionMask|EnterWindowMask
-		|LeaveWindowMask|StructureNotifyMask|PropertyChangeMask;
+	wa.event_mask = ROOTMASK;
 	XChangeWindowAttributes(dpy, root, CWEventMask|CWCursor, &wa);
 	XSelectInput(dpy, root, wa.event_mask);
+	updatenumlockmask();
 	grabkeys();
 	focus(NULL);
+	ipcsetup();
 	spawnbar();
 }
 
@@ -1705,21 +3163,65 @@ seturgent(Client *c, int urg)
 	XFree(wmh);
 }
 
+void
+setwindowtype(Client *c, Atom state, Atom wtype)
+{
+	if (state == netatom[NetWMFullscreen])
+		setfullscreen(c, 1);
+	if (wtype == netatom[NetWMWindowTypeDialog])
+		c->isfloating = 1;
+}
+
+void
+setwmhints(Client *c, XWMHints *wmh)
+{
+	if (c == selmon->sel && wmh->flags & XUrgencyHint) {
+		wmh->flags &= ~XUrgencyHint;
+		XSetWMHints(dpy, c->win, wmh);
+	} else
+		c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
+	if (wmh->flags & InputHint)
+		c->neverfocus = !wmh->input;
+	else
+		c->neverfocus = 0;
+}
+
+/* Shows the visible clients of the stack starting at c and hides the
+ * others, moving only windows that are not yet where they belong. */
 void
 showhide(Client *c)
 {
-	if (!c)
-		return;
-	if (ISVISIBLE(c)) {
-		/* show clients top down */
-		XMoveWindow(dpy, c->win, c->x, c->y);
+	size_t n = 0;
+
+	/* show clients top down */
+	for (; c; c = c->snext) {
+		if (!ISVISIBLE(c)) {
+			if (n == hidebufsz) {
+				hidebufsz = hidebufsz ? 2 * hidebufsz : 32;
+				if (!(hidebuf = realloc(hidebuf, hidebufsz * sizeof(Client *))))
+					die("realloc:");
+			}
+			hidebuf[n++] = c;
+			continue;
+		}
+		if (c->offscreen) {
+			XMoveWindow(dpy, c->win, c->x, c->y);
+			c->offscreen = 0;
+		}
+		if (c->ishidden)
+			sethidden(c, 0);
 		if ((!c->mon->lt[c->mon->sellt]->arrange || c->isfloating) && !c->isfullscreen)
 			resize(c, c->x, c->y, c->w, c->h, 0);
-		showhide(c->snext);
-	} else {
-		/* hide clients bottom up */
-		showhide(c->snext);
-		XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
+	}
+	/* hide clients bottom up */
+	while (n--) {
+		c = hidebuf[n];
+		if (!hideunmap && !c->offscreen) {
+			XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
+			c->offscreen = 1;
+		}
+		if (!c->ishidden)
+			sethidden(c, 1);
 	}
 }
 
@@ -1731,6 +3233,14 @@ sigchld(int unused)
 	while (0 < waitpid(-1, NULL, WNOHANG));
 }
 
+#ifdef TRACE
+void
+sigtrace(int unused)
+{
+	tracesig = 1; /* run() dumps, outside of the handler */
+}
+#endif /* TRACE */
+
 void
 spawn(const Arg *arg)
 {
@@ -1754,6 +3264,85 @@ spawnbar()
 		system(altbarcmd);
 }
 
+#ifdef XSYNC
+/* Asks c to tell through its counter when it drew the size it is about to
+ * be configured to. */
+void
+syncrequest(Client *c)
+{
+	int overflow;
+	XEvent ev;
+	XSyncValue one;
+	XSyncAlarmAttributes aa;
+
+	if (dragsync.alarm == None)
+		return;
+	XSyncIntToValue(&one, 1);
+	XSyncValueAdd(&dragsync.value, dragsync.value, one, &overflow);
+	ev.type = ClientMessage;
+	ev.xclient.window = c->win;
+	ev.xclient.message_type = wmatom[WMProtocols];
+	ev.xclient.format = 32;
+	ev.xclient.data.l[0] = netatom[NetWMSyncRequest];
+	ev.xclient.data.l[1] = CurrentTime;
+	ev.xclient.data.l[2] = XSyncValueLow32(dragsync.value);
+	ev.xclient.data.l[3] = XSyncValueHigh32(dragsync.value);
+	ev.xclient.data.l[4] = 0;
+	XSendEvent(dpy, c->win, False, NoEventMask, &ev);
+	aa.trigger.wait_value = dragsync.value;
+	XSyncChangeAlarm(dpy, dragsync.alarm, XSyncCAValue, &aa);
+	dragsync.waiting = 1;
+	dragsync.sent = msnow();
+}
+
+/* Sets up an alarm on the sync counter of c, if it has one. */
+void
+syncstart(Client *c)
+{
+	int n, format, exists = 0;
+	unsigned long nitems, after;
+	unsigned char *p = NULL;
+	Atom *protocols, type;
+	XSyncAlarmAttributes aa;
+
+	dragsync.alarm = None;
+	dragsync.waiting = 0;
+	if (syncevbase < 0)
+		return;
+	if (XGetWMProtocols(dpy, c->win, &protocols, &n)) {
+		while (!exists && n--)
+			exists = protocols[n] == netatom[NetWMSyncRequest];
+		XFree(protocols);
+	}
+	if (!exists || XGetWindowProperty(dpy, c->win, netatom[NetWMSyncRequestCounter],
+		0L, 1L, False, XA_CARDINAL, &type, &format, &nitems, &after, &p) != Success)
+		return;
+	dragsync.counter = (p && nitems && format == 32) ? *(XSyncCounter *)p : None;
+	XFree(p);
+	/* the counter is the client's, it may be gone already */
+	if (dragsync.counter == None
+	|| !XSyncQueryCounter(dpy, dragsync.counter, &dragsync.value))
+		return;
+	aa.trigger.counter = dragsync.counter;
+	aa.trigger.value_type = XSyncAbsolute;
+	aa.trigger.wait_value = dragsync.value;
+	aa.trigger.test_type = XSyncPositiveComparison;
+	XSyncIntToValue(&aa.delta, 0);
+	aa.events = True;
+	dragsync.alarm = XSyncCreateAlarm(dpy, XSyncCACounter|XSyncCAValueType
+		|XSyncCAValue|XSyncCATestType|XSyncCADelta|XSyncCAEvents, &aa);
+}
+
+void
+syncstop(void)
+{
+	if (dragsync.alarm != None)
+		XSyncDestroyAlarm(dpy, dragsync.alarm);
+	dragsync.alarm = None;
+	dragsync.waiting = 0;
+}
+#endif /* XSYNC */
+
 void
 tag(const Arg *arg)
 {
@@ -1772,6 +3361,23 @@ tagmon(const Arg *arg)
 	sendmon(selmon->sel, dirtomon(arg->i));
 }
 
+void
+textpropcopy(XTextProperty *name, char *text, unsigned int size)
+{
+	char **list = NULL;
+	int n;
+
+	if (name->encoding == XA_STRING)
+		strncpy(text, (char *)name->value, size - 1);
+	else {
+		if (XmbTextPropertyToTextList(dpy, name, &list, &n) >= Success && n > 0 && *list) {
+			strncpy(text, *list, size - 1);
+			XFreeStringList(list);
+		}
+	}
+	text[size - 1] = '\0';
+}
+
 void
 tile(Monitor *m)
 {
@@ -1859,6 +3465,103 @@ toggleview(const Arg *arg)
 	}
 }
 
+#ifdef TRACE
+void
+tracebegin(TraceMark *tm)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	tm->us = ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	tm->req = XNextRequest(dpy);
+	tm->rtt = tracertts;
+}
+
+/* Writes the statistics and the slow calls to cn, or stderr if it is NULL,
+ * one record per line:
+ *   total requests round-trips       (since dwm started, never reset)
+ *   stat name calls total-us max-us requests round-trips hist...
+ *   slow ms-ago name window us requests round-trips */
+void
+tracedump(IpcConn *cn, int reset)
+{
+	char hist[TRACEBUCKETS * 21 + 1]; /* " %lu" of a 64 bit ULONG_MAX each */
+	unsigned int i, j, len;
+	long now = msnow();
+	TraceSlow *sl;
+	TraceStat *st;
+
+	traceout(cn, "total %lu %lu\n", XNextRequest(dpy) - 1, tracertts);
+	for (i = 0; i < TraceLast; i++) {
+		st = &tracestats[i];
+		if (!st->n)
+			continue;
+		for (len = j = 0; j < TRACEBUCKETS && len < sizeof hist; j++)
+			len += snprintf(hist + len, sizeof hist - len, " %lu", st->hist[j]);
+		traceout(cn, "stat %s %lu %lu %lu %lu %lu%s\n",
+			tracenames[i] ? tracenames[i] : "other",
+			st->n, st->us, st->max, st->reqs, st->rtts, hist);
+	}
+	for (i = 0; i < TRACERING; i++) {
+		sl = &traceslow[(traceslowpos + i) % TRACERING];
+		if (sl->when)
+			traceout(cn, "slow %ld %s 0x%lx %lu %lu %lu\n", now - sl->when,
+				tracenames[sl->slot] ? tracenames[sl->slot] : "other",
+				sl->win, sl->us, sl->reqs, sl->rtts);
+	}
+	if (reset) {
+		memset(tracestats, 0, sizeof tracestats);
+		memset(traceslow, 0, sizeof traceslow);
+	}
+}
+
+void
+traceend(TraceMark *tm, int slot, Window win)
+{
+	struct timespec ts;
+	unsigned long us, reqs, rtts;
+	unsigned int b;
+	TraceStat *st = &tracestats[slot];
+	TraceSlow *sl;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	us = ts.tv_sec * 1000000 + ts.tv_nsec / 1000 - tm->us;
+	reqs = XNextRequest(dpy) - tm->req;
+	rtts = tracertts - tm->rtt;
+	st->n++;
+	st->us += us;
+	st->max = MAX(st->max, us);
+	st->reqs += reqs;
+	st->rtts += rtts;
+	for (b = 0; b < TRACEBUCKETS - 1 && us >> (b + 1); b++);
+	st->hist[b]++;
+	if (us >= TRACESLOW) {
+		sl = &traceslow[traceslowpos++ % TRACERING];
+		sl->when = msnow();
+		sl->slot = slot;
+		sl->win = win;
+		sl->us = us;
+		sl->reqs = reqs;
+		sl->rtts = rtts;
+	}
+}
+
+void
+traceout(IpcConn *cn, const char *fmt, ...)
+{
+	char buf[512];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof buf, fmt, ap);
+	va_end(ap);
+	if (cn)
+		ipcsend(cn, "%s", buf);
+	else
+		fputs(buf, stderr);
+}
+#endif /* TRACE */
+
 void
 unfocus(Client *c, int setfocus)
 {
@@ -1886,6 +3589,11 @@ unmanage(Client *c, int destroyed)
 		XSetErrorHandler(xerrordummy);
 		XConfigureWindow(dpy, c->win, CWBorderWidth, &wc); /* restore border */
 		XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
+		if (c->ishidden) {
+			/* whoever manages it next may not hide it */
+			c->ishidden = 0;
+			setnetstate(c);
+		}
 		setclientstate(c, WithdrawnState);
 		XSync(dpy, False);
 		XSetErrorHandler(xerror);
@@ -1893,7 +3601,6 @@ unmanage(Client *c, int destroyed)
 	}
 	free(c);
 	focus(NULL);
-	updateclientlist();
 	arrange(m);
 }
 
@@ -1905,9 +3612,11 @@ unmanagealtbar(Window w)
     if (!m)
         return;
 
+    winindexdel(w);
     m->barwin = 0;
     m->by = 0;
     m->bh = 0;
+    clientlistdirty = 1;
     updatebarpos(m);
     arrange(m);
 }
@@ -1920,9 +3629,11 @@ unmanagetray(Window w)
 	if (!m)
 		return;
 
+	winindexdel(w);
 	m->traywin = 0;
 	m->tx = 0;
 	m->tw = 0;
+	clientlistdirty = 1;
 	updatebarpos(m);
 	arrange(m);
 }
@@ -1964,6 +3675,7 @@ updatebars(void)
 		m->barwin = XCreateWindow(dpy, root, m->wx, m->by, m->ww, bh, 0, DefaultDepth(dpy, screen),
 				CopyFromParent, DefaultVisual(dpy, screen),
 				CWOverrideRedirect|CWBackPixmap|CWEventMask, &wa);
+		winindexput(m->barwin, NULL, m);
 		XDefineCursor(dpy, m->barwin, cursor[CurNormal]->cursor);
 		XMapRaised(dpy, m->barwin);
 		XSetClassHint(dpy, m->barwin, &ch);
@@ -1988,13 +3700,33 @@ updateclientlist()
 {
 	Client *c;
 	Monitor *m;
+	Window *list, *stack;
+	size_t n = 0, nl = 0, ns = 0, i;
 
-	XDeleteProperty(dpy, root, netatom[NetClientList]);
+	clientlistdirty = 0;
+	for (m = mons; m; m = m->next)
+		for (n += 2, c = m->clients; c; c = c->next)
+			n++;
+	list = ecalloc(n, sizeof(Window));
+	stack = ecalloc(n, sizeof(Window));
 	for (m = mons; m; m = m->next)
 		for (c = m->clients; c; c = c->next)
-			XChangeProperty(dpy, root, netatom[NetClientList],
-				XA_WINDOW, 32, PropModeAppend,
-				(unsigned char *) &(c->win), 1);
+			list[nl++] = c->win;
+	for (m = mons; m; m = m->next) {
+		if (usealtbar && m->barwin)
+			list[nl++] = m->barwin;
+		if (m->traywin)
+			list[nl++] = m->traywin;
+	}
+	/* bottom to top, the most recently focused client last */
+	for (m = mons; m; m = m->next) {
+		for (i = 0, c = m->stack; c; c = c->snext)
+			i++;
+		for (ns += i, i = ns, c = m->stack; c; c = c->snext)
+			stack[--i] = c->win;
+	}
+	publishlist(netatom[NetClientList], list, nl, &netclients, &nnetclients);
+	publishlist(netatom[NetClientListStacking], stack, ns, &netstacking, &nnetstacking);
 }
 
 int
@@ -2002,6 +3734,9 @@ updategeom(void)
 {
 	int dirty = 0;
 
+#ifdef XRANDR
+	if (!randrgeom(&dirty))
+#endif /* XRANDR */
 #ifdef XINERAMA
 	if (XineramaIsActive(dpy)) {
 		int i, j, n, nn;
@@ -2038,6 +3773,7 @@ updategeom(void)
 					m->mw = m->ww = unique[i].width;
 					m->mh = m->wh = unique[i].height;
 					updatebarpos(m);
+					m->resized = 1;
 				}
 		} else { /* less monitors available nn < n */
 			for (i = nn; i < n; i++) {
@@ -2049,6 +3785,7 @@ updategeom(void)
 					c->mon = mons;
 					attach(c);
 					attachstack(c);
+					mons->resized = 1;
 				}
 				if (m == selmon)
 					selmon = mons;
@@ -2066,6 +3803,7 @@ updategeom(void)
 			mons->mw = mons->ww = sw;
 			mons->mh = mons->wh = sh;
 			updatebarpos(mons);
+			mons->resized = 1;
 		}
 	}
 	if (dirty) {
@@ -2075,6 +3813,33 @@ updategeom(void)
 	return dirty;
 }
 
+/* Applies what updategeom() found. Only monitors whose geometry changed
+ * get their bar and fullscreen clients moved and are arranged again. */
+void
+updatemons(void)
+{
+	Client *c;
+	Monitor *m;
+
+	if (drw->w != (unsigned int)sw)
+		drw_resize(drw, sw, bh);
+	if (!updategeom())
+		return;
+	updatebars();
+	for (m = mons; m; m = m->next) {
+		if (!m->resized)
+			continue;
+		m->resized = 0;
+		for (c = m->clients; c; c = c->next)
+			if (c->isfullscreen)
+				resizeclient(c, m->mx, m->my, m->mw, m->mh);
+		XMoveResizeWindow(dpy, m->barwin, m->wx, m->by, m->ww, m->bh);
+		m->drawn.valid = 0;
+		m->pending |= PendArrange|PendRestack;
+	}
+	focus(NULL);
+}
+
 void
 updatenumlockmask(void)
 {
@@ -2100,38 +3865,7 @@ updatesizehints(Client *c)
 	if (!XGetWMNormalHints(dpy, c->win, &size, &msize))
 		/* size is uninitialized, ensure that size.flags aren't used */
 		size.flags = PSize;
-	if (size.flags & PBaseSize) {
-		c->basew = size.base_width;
-		c->baseh = size.base_height;
-	} else if (size.flags & PMinSize) {
-		c->basew = size.min_width;
-		c->baseh = size.min_height;
-	} else
-		c->basew = c->baseh = 0;
-	if (size.flags & PResizeInc) {
-		c->incw = size.width_inc;
-		c->inch = size.height_inc;
-	} else
-		c->incw = c->inch = 0;
-	if (size.flags & PMaxSize) {
-		c->maxw = size.max_width;
-		c->maxh = size.max_height;
-	} else
-		c->maxw = c->maxh = 0;
-	if (size.flags & PMinSize) {
-		c->minw = size.min_width;
-		c->minh = size.min_height;
-	} else if (size.flags & PBaseSize) {
-		c->minw = size.base_width;
-		c->minh = size.base_height;
-	} else
-		c->minw = c->minh = 0;
-	if (size.flags & PAspect) {
-		c->mina = (float)size.min_aspect.y / size.min_aspect.x;
-		c->maxa = (float)size.max_aspect.x / size.max_aspect.y;
-	} else
-		c->maxa = c->mina = 0.0;
-	c->isfixed = (c->maxw && c->maxh && c->maxw == c->minw && c->maxh == c->minh);
+	setsizehints(c, &size);
 }
 
 void
@@ -2139,7 +3873,7 @@ updatestatus(void)
 {
 	if (!gettextprop(root, XA_WM_NAME, stext, sizeof(stext)))
 		strcpy(stext, "dwm-"VERSION);
-	drawbar(selmon);
+	selmon->pending |= PendLazyDraw;
 }
 
 void
@@ -2154,13 +3888,8 @@ updatetitle(Client *c)
 void
 updatewindowtype(Client *c)
 {
-	Atom state = getatomprop(c, netatom[NetWMState]);
-	Atom wtype = getatomprop(c, netatom[NetWMWindowType]);
-
-	if (state == netatom[NetWMFullscreen])
-		setfullscreen(c, 1);
-	if (wtype == netatom[NetWMWindowTypeDialog])
-		c->isfloating = 1;
+	setwindowtype(c, getatomprop(c->win, netatom[NetWMState]),
+		getatomprop(c->win, netatom[NetWMWindowType]));
 }
 
 void
@@ -2169,15 +3898,7 @@ updatewmhints(Client *c)
 	XWMHints *wmh;
 
 	if ((wmh = XGetWMHints(dpy, c->win))) {
-		if (c == selmon->sel && wmh->flags & XUrgencyHint) {
-			wmh->flags &= ~XUrgencyHint;
-			XSetWMHints(dpy, c->win, wmh);
-		} else
-			c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
-		if (wmh->flags & InputHint)
-			c->neverfocus = !wmh->input;
-		else
-			c->neverfocus = 0;
+		setwmhints(c, wmh);
 		XFree(wmh);
 	}
 }
@@ -2194,36 +3915,167 @@ view(const Arg *arg)
 	arrange(selmon);
 }
 
+static size_t
+winhash(Window w)
+{
+	/* XIDs of one X client share their high bits, so mix them in */
+	return (size_t)(w * 2654435761UL) & (wintabsz - 1);
+}
+
+void
+winindexdel(Window w)
+{
+	WinSlot *s;
+	size_t i, j, k;
+
+	if (!(s = winindexget(w)))
+		return;
+	/* backward shift deletion, keeps probe chains intact without tombstones */
+	for (i = j = s - wintab;;) {
+		j = (j + 1) & (wintabsz - 1);
+		if (!wintab[j].win)
+			break;
+		k = winhash(wintab[j].win);
+		if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+			wintab[i] = wintab[j];
+			i = j;
+		}
+	}
+	memset(&wintab[i], 0, sizeof(WinSlot));
+	wintabused--;
+}
+
+WinSlot *
+winindexget(Window w)
+{
+	size_t i;
+
+	if (!w || !wintabsz)
+		return NULL;
+	for (i = winhash(w); wintab[i].win; i = (i + 1) & (wintabsz - 1))
+		if (wintab[i].win == w)
+			return &wintab[i];
+	return NULL;
+}
+
+void
+winindexput(Window w, Client *c, Monitor *m)
+{
+	WinSlot *old;
+	size_t i, n;
+
+	if (!w)
+		return;
+	if (2 * (wintabused + 1) > wintabsz) { /* keep the load factor below 1/2 */
+		old = wintab;
+		n = wintabsz;
+		wintabsz = n ? 2 * n : 64;
+		wintab = ecalloc(wintabsz, sizeof(WinSlot));
+		wintabused = 0;
+		for (i = 0; i < n; i++)
+			if (old[i].win)
+				winindexput(old[i].win, old[i].c, old[i].m);
+		free(old);
+	}
+	for (i = winhash(w); wintab[i].win && wintab[i].win != w; i = (i + 1) & (wintabsz - 1));
+	if (!wintab[i].win)
+		wintabused++;
+	wintab[i].win = w;
+	wintab[i].c = c;
+	wintab[i].m = m;
+}
+
+#ifdef XCB
+/* wmclasscontains() for a window fetched with wininfofetch() */
+int
+wininfoclasscontains(WinInfo *wi, const char *class, const char *name)
+{
+	return wi->hasclass && strstr(wi->instance, name) && strstr(wi->class, class);
+}
+
+void
+wininfofetch(WinInfo *wi)
+{
+	xcb_connection_t *xc = XGetXCBConnection(dpy);
+
+	wi->attrs = xcb_get_window_attributes(xc, wi->win);
+	wi->geom = xcb_get_geometry(xc, wi->win);
+	wi->trans = xcb_get_property(xc, 0, wi->win, XA_WM_TRANSIENT_FOR, XA_WINDOW, 0, 1);
+	wi->wmclass = xcb_get_property(xc, 0, wi->win, XA_WM_CLASS, XA_STRING, 0, 64);
+	wi->wmstate = xcb_get_property(xc, 0, wi->win, wmatom[WMState], wmatom[WMState], 0, 2);
+}
+
+void
+wininforeply(WinInfo *wi)
+{
+	xcb_connection_t *xc = XGetXCBConnection(dpy);
+	xcb_get_window_attributes_reply_t *ar;
+	xcb_get_geometry_reply_t *gr;
+	xcb_get_property_reply_t *pr;
+	const char *p;
+	int len, n;
+
+	ar = xcb_get_window_attributes_reply(xc, wi->attrs, NULL);
+	gr = xcb_get_geometry_reply(xc, wi->geom, NULL);
+	if (ar && gr) {
+		wi->ok = 1;
+		wi->wa.x = gr->x;
+		wi->wa.y = gr->y;
+		wi->wa.width = gr->width;
+		wi->wa.height = gr->height;
+		wi->wa.border_width = gr->border_width;
+		wi->wa.override_redirect = ar->override_redirect;
+		wi->wa.map_state = ar->map_state;
+	}
+	free(ar);
+	free(gr);
+	if ((pr = xcb_get_property_reply(xc, wi->trans, NULL))) {
+		wi->transient = propcard32(pr, XA_WINDOW, 0, -1) != -1;
+		free(pr);
+	}
+	if ((pr = xcb_get_property_reply(xc, wi->wmstate, NULL))) {
+		wi->state = propcard32(pr, wmatom[WMState], 0, -1);
+		free(pr);
+	} else
+		wi->state = -1;
+	/* same as XGetClassHint(): "instance\0class\0" */
+	if ((pr = xcb_get_property_reply(xc, wi->wmclass, NULL))) {
+		if (pr->type == XA_STRING && pr->format == 8) {
+			wi->hasclass = 1;
+			p = xcb_get_property_value(pr);
+			len = xcb_get_property_value_length(pr);
+			for (n = 0; n < len && p[n]; n++);
+			snprintf(wi->instance, sizeof wi->instance, "%.*s", n, p);
+			snprintf(wi->class, sizeof wi->class, "%.*s",
+				n < len ? (int)strnlen(p + n + 1, len - n - 1) : 0, n < len ? p + n + 1 : "");
+		}
+		free(pr);
+	}
+}
+#endif /* XCB */
+
 Client *
 wintoclient(Window w)
 {
-	Client *c;
-	Monitor *m;
+	WinSlot *s = winindexget(w);
 
-	for (m = mons; m; m = m->next)
-		for (c = m->clients; c; c = c->next)
-			if (c->win == w)
-				return c;
-	return NULL;
+	return s ? s->c : NULL;
 }
 
 Monitor *
 wintomon(Window w)
 {
 	int x, y;
-	Client *c;
-	Monitor *m;
+	WinSlot *s;
 
 	if (w == root && getrootptr(&x, &y))
 		return recttomon(x, y, 1, 1);
-	for (m = mons; m; m = m->next)
-		if (w == m->barwin || w == m->traywin)
-			return m;
-	if ((c = wintoclient(w)))
-		return c->mon;
+	if ((s = winindexget(w)))
+		return s->m ? s->m : s->c->mon;
 	return selmon;
 }
 
+#ifndef XCB
 int
 wmclasscontains(Window win, const char *class, const char *name)
 {
@@ -2245,6 +4097,7 @@ wmclasscontains(Window win, const char *class, const char *name)
 
 	return res;
 }
+#endif /* XCB */
 
 /* There's no way to check accesses to destroyed windows, thus those cases are
  * ignored (especially on UnmapNotify's). Other types of errors call Xlibs
@@ -2262,6 +4115,11 @@ xerror(Display *dpy, XErrorEvent *ee)
 	|| (ee->request_code == X_GrabKey && ee->error_code == BadAccess)
 	|| (ee->request_code == X_CopyArea && ee->error_code == BadDrawable))
 		return 0;
+#ifdef XSYNC
+	/* sync counters belong to clients, which may destroy them any time */
+	if (syncerrbase >= 0 && ee->error_code == syncerrbase + XSyncBadCounter)
+		return 0;
+#endif /* XSYNC */
 	fprintf(stderr, "dwm: fatal error: request code=%d, error code=%d\n",
 		ee->request_code, ee->error_code);
 	return xerrorxlib(dpy, ee); /* may call exit */
@@ -2310,7 +4168,7 @@ main(int argc, char *argv[])
 	checkotherwm();
 	setup();
 #ifdef __OpenBSD__
-	if (pledge("stdio rpath proc exec", NULL) == -1)
+	if (pledge("stdio rpath proc exec unix", NULL) == -1)
 		die("pledge");
 #endif /* __OpenBSD__ */
 	scan();
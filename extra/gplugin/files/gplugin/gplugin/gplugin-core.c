@@ -37,6 +37,11 @@
  * @GPLUGIN_CORE_FLAGS_DISABLE_NATIVE_LOADER: Disable the native plugin loader.
  * @GPLUGIN_CORE_FLAGS_LOG_PLUGIN_STATE_CHANGES: Log plugin state changes with
  *                                               g_message. Since: 0.34.0
+ * @GPLUGIN_CORE_FLAGS_QUERY_IN_HELPER: Query new plugins in a separate
+ *                                      process first so that a plugin that
+ *                                      crashes or hangs while being queried
+ *                                      is skipped instead of taking down the
+ *                                      application. Since: 0.35.0
  *
  * Flags to configure behaviors in GPlugin.
  *
@@ -32,6 +32,7 @@ typedef enum /*< flags,prefix=GPLUGIN_CORE_FLAGS,underscore_name=GPLUGIN_CORE >*
 	GPLUGIN_CORE_FLAGS_NONE = 0,
 	GPLUGIN_CORE_FLAGS_DISABLE_NATIVE_LOADER = 1 << 0,
 	GPLUGIN_CORE_FLAGS_LOG_PLUGIN_STATE_CHANGES = 1 << 1,
+	GPLUGIN_CORE_FLAGS_QUERY_IN_HELPER = 1 << 2,
 } GPluginCoreFlags;
 /* clang-format on */
 
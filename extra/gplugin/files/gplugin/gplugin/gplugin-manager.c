@@ -20,12 +20,14 @@
 
 #include <glib.h>
 #include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
 
 #include <gplugin/gplugin-core.h>
 #include <gplugin/gplugin-file-tree.h>
 #include <gplugin/gplugin-manager.h>
 #include <gplugin/gplugin-native-loader.h>
 #include <gplugin/gplugin-private.h>
+#include <gplugin/gplugin-query-sandbox.h>
 
 /**
  * SECTION:gplugin-manager
@@ -53,6 +55,7 @@
  * @unloading_plugin: Signal emitted before a plugin is unloaded.
  * @unloaded_plugin: Signal emitted after a plugin is unloaded.
  * @unload_plugin_failed: Signal emitted when a plugin fails to unload.
+ * @plugins_changed: Signal emitted when a batch of plugin changes ends.
  *
  * Virtual function table for #GPluginManager.
  */
@@ -67,6 +70,7 @@ enum {
 	SIG_UNLOADING,
 	SIG_UNLOADED,
 	SIG_UNLOAD_FAILED,
+	SIG_PLUGINS_CHANGED,
 	N_SIGNALS,
 };
 
@@ -84,8 +88,33 @@ typedef struct {
 	GHashTable *loaders_by_extension;
 
 	gboolean refresh_needed;
+
+	guint batch_depth;
+	GHashTable *batch_plugins;
+
+	GHashTable *query_cache;
+
+	GHashTable *proxies;
 } GPluginManagerPrivate;
 
+/* An entry in the query cache for a file that crashed or hung the query
+ * helper.  The file is skipped until its mtime changes.
+ */
+typedef struct {
+	gint64 mtime;
+	gchar *message;
+} GPluginManagerQueryCacheEntry;
+
+/* A node in the graph that gplugin_manager_unload_all() walks.  dependencies
+ * holds the nodes of the loaded plugins that this plugin depends on, and
+ * dependents is the number of loaded plugins that still depend on this one.
+ */
+typedef struct {
+	GPluginPlugin *plugin;
+	GSList *dependencies;
+	guint dependents;
+} GPluginManagerUnloadNode;
+
 G_DEFINE_TYPE_WITH_PRIVATE(GPluginManager, gplugin_manager, G_TYPE_OBJECT);
 
 /******************************************************************************
@@ -100,6 +129,9 @@ const gchar *dependency_pattern =
 	"^(?P<id>.+?)((?P<op>\\<=|\\<|==|=|\\>=|\\>)(?P<version>.+))?$";
 GRegex *dependency_regex = NULL;
 
+/* how long, in milliseconds, the query helper may spend on a single plugin */
+#define GPLUGIN_MANAGER_QUERY_TIMEOUT (5000)
+
 /******************************************************************************
  * Helpers
  *****************************************************************************/
@@ -131,33 +163,257 @@ gplugin_manager_remove_list_value(
 }
 
 static void
-gplugin_manager_foreach_unload_plugin(
-	gpointer key,
-	gpointer value,
-	G_GNUC_UNUSED gpointer data)
+gplugin_manager_unload_node_free(gpointer data)
 {
-	GList *l = NULL;
-	gchar *id = (gchar *)key;
+	GPluginManagerUnloadNode *node = (GPluginManagerUnloadNode *)data;
 
-	for(l = (GList *)value; l; l = l->next) {
-		GPluginPlugin *plugin = GPLUGIN_PLUGIN(l->data);
-		GPluginLoader *loader = NULL;
-		GError *error = NULL;
+	g_slist_free(node->dependencies);
+	g_object_unref(G_OBJECT(node->plugin));
+	g_free(node);
+}
 
-		if(gplugin_plugin_get_state(plugin) != GPLUGIN_PLUGIN_STATE_LOADED) {
-			continue;
+static GHashTable *
+gplugin_manager_build_unload_graph(GPluginManager *manager)
+{
+	GHashTable *nodes = NULL;
+	GHashTableIter iter;
+	GSList *loaded = NULL, *l = NULL;
+	gpointer value = NULL;
+
+	nodes = g_hash_table_new_full(
+		g_direct_hash,
+		g_direct_equal,
+		NULL,
+		gplugin_manager_unload_node_free);
+
+	loaded = gplugin_manager_find_plugins_with_state(
+		manager,
+		GPLUGIN_PLUGIN_STATE_LOADED);
+	for(l = loaded; l != NULL; l = l->next) {
+		GPluginManagerUnloadNode *node = g_new0(GPluginManagerUnloadNode, 1);
+
+		/* the node takes over the reference that the list was holding */
+		node->plugin = GPLUGIN_PLUGIN(l->data);
+
+		g_hash_table_insert(nodes, node->plugin, node);
+	}
+	g_slist_free(loaded);
+
+	/* Now link every node to the nodes of the loaded plugins that it depends
+	 * on.  Dependencies that can't be resolved or aren't loaded are ignored as
+	 * there's nothing to order them against.
+	 */
+	g_hash_table_iter_init(&iter, nodes);
+	while(g_hash_table_iter_next(&iter, NULL, &value)) {
+		GPluginManagerUnloadNode *node = (GPluginManagerUnloadNode *)value;
+		GSList *dependencies = NULL;
+
+		dependencies =
+			gplugin_manager_get_plugin_dependencies(manager, node->plugin, NULL);
+		for(l = dependencies; l != NULL; l = l->next) {
+			GPluginManagerUnloadNode *dependency = NULL;
+
+			dependency = g_hash_table_lookup(nodes, l->data);
+			if(dependency == NULL || dependency == node) {
+				continue;
+			}
+
+			node->dependencies =
+				g_slist_prepend(node->dependencies, dependency);
+			dependency->dependents++;
 		}
+		g_slist_free_full(dependencies, g_object_unref);
+	}
 
-		loader = gplugin_plugin_get_loader(plugin);
-		if(!gplugin_loader_unload_plugin(loader, plugin, &error)) {
-			g_warning(
-				"failed to unload plugin with id %s: %s",
-				id,
-				error ? error->message : "unknown");
-			g_clear_error(&error);
+	return nodes;
+}
+
+/* Steals every node that no loaded plugin depends on anymore out of nodes and
+ * returns them.  None of the plugins in the returned wave depend on each other.
+ */
+static GSList *
+gplugin_manager_steal_unload_wave(GHashTable *nodes)
+{
+	GHashTableIter iter;
+	GSList *wave = NULL;
+	gpointer value = NULL;
+
+	g_hash_table_iter_init(&iter, nodes);
+	while(g_hash_table_iter_next(&iter, NULL, &value)) {
+		GPluginManagerUnloadNode *node = (GPluginManagerUnloadNode *)value;
+
+		if(node->dependents == 0) {
+			g_hash_table_iter_steal(&iter);
+			wave = g_slist_prepend(wave, node);
 		}
-		g_object_unref(G_OBJECT(loader));
 	}
+
+	return wave;
+}
+
+static void
+gplugin_manager_append_plugin_id(GString *str, GPluginPlugin *plugin)
+{
+	GPluginPluginInfo *info = gplugin_plugin_get_info(plugin);
+
+	if(str->len > 0) {
+		g_string_append(str, ", ");
+	}
+
+	g_string_append(str, gplugin_plugin_info_get_id(info));
+
+	g_object_unref(G_OBJECT(info));
+}
+
+/* Unloads every loaded plugin in reverse dependency order, so a plugin is only
+ * unloaded once nothing that depends on it is loaded anymore.  If a plugin
+ * fails to unload, the plugins it depends on are left loaded as well.
+ *
+ * If emit_signals is FALSE the loaders are called directly, which is what we
+ * want while the manager is being finalized.
+ */
+static gboolean
+gplugin_manager_unload_ordered(
+	GPluginManager *manager,
+	gboolean emit_signals,
+	guint timeout,
+	guint plugin_timeout,
+	GError **error)
+{
+	GHashTable *nodes = NULL;
+	GHashTableIter iter;
+	GSList *wave = NULL, *l = NULL;
+	GString *remaining = NULL;
+	gpointer value = NULL;
+	gint64 deadline = G_MAXINT64;
+
+	if(timeout > 0) {
+		deadline = g_get_monotonic_time() +
+				   (gint64)timeout * G_TIME_SPAN_MILLISECOND;
+	}
+
+	nodes = gplugin_manager_build_unload_graph(manager);
+	remaining = g_string_new(NULL);
+
+	while((wave = gplugin_manager_steal_unload_wave(nodes)) != NULL) {
+		/* The plugins in a wave are independent of each other, but the
+		 * loaders are not thread safe, so they are still unloaded one at a
+		 * time.
+		 */
+		for(l = wave; l != NULL; l = l->next) {
+			GPluginManagerUnloadNode *node = (GPluginManagerUnloadNode *)l->data;
+			GError *ourerror = NULL;
+			GSList *ll = NULL;
+			gint64 start = 0, elapsed = 0;
+			gboolean unloaded = FALSE;
+
+			start = g_get_monotonic_time();
+			if(start >= deadline) {
+				gplugin_manager_append_plugin_id(remaining, node->plugin);
+
+				continue;
+			}
+
+			if(emit_signals) {
+				unloaded = gplugin_manager_unload_plugin(
+					manager,
+					node->plugin,
+					&ourerror);
+			} else {
+				GPluginLoader *loader = gplugin_plugin_get_loader(node->plugin);
+
+				unloaded = gplugin_loader_unload_plugin(
+					loader,
+					node->plugin,
+					&ourerror);
+
+				g_object_unref(G_OBJECT(loader));
+			}
+			g_clear_error(&ourerror);
+
+			/* The loaders unload in process and can't be interrupted, so a
+			 * plugin that runs over a limit is only reported.
+			 */
+			elapsed = g_get_monotonic_time() - start;
+			if(plugin_timeout > 0 &&
+			   elapsed > (gint64)plugin_timeout * G_TIME_SPAN_MILLISECOND) {
+				GPluginPluginInfo *info = gplugin_plugin_get_info(node->plugin);
+
+				g_warning(
+					_("plugin %s took %" G_GINT64_FORMAT
+					  " ms to unload and ran over its limit of %u ms"),
+					gplugin_plugin_info_get_id(info),
+					elapsed / G_TIME_SPAN_MILLISECOND,
+					plugin_timeout);
+
+				g_object_unref(G_OBJECT(info));
+			} else if(timeout > 0 && start + elapsed > deadline) {
+				GPluginPluginInfo *info = gplugin_plugin_get_info(node->plugin);
+
+				g_warning(
+					_("plugin %s took %" G_GINT64_FORMAT
+					  " ms to unload and ran over the budget of %u ms"),
+					gplugin_plugin_info_get_id(info),
+					elapsed / G_TIME_SPAN_MILLISECOND,
+					timeout);
+
+				g_object_unref(G_OBJECT(info));
+			}
+
+			if(!unloaded) {
+				gplugin_manager_append_plugin_id(remaining, node->plugin);
+
+				continue;
+			}
+
+			for(ll = node->dependencies; ll != NULL; ll = ll->next) {
+				GPluginManagerUnloadNode *dependency = ll->data;
+
+				dependency->dependents--;
+			}
+		}
+
+		g_slist_free_full(wave, gplugin_manager_unload_node_free);
+	}
+
+	/* Anything that's left couldn't be unloaded because something that
+	 * depends on it is still loaded.
+	 */
+	g_hash_table_iter_init(&iter, nodes);
+	while(g_hash_table_iter_next(&iter, NULL, &value)) {
+		GPluginManagerUnloadNode *node = (GPluginManagerUnloadNode *)value;
+
+		gplugin_manager_append_plugin_id(remaining, node->plugin);
+	}
+	g_hash_table_destroy(nodes);
+
+	if(remaining->len > 0) {
+		if(g_get_monotonic_time() >= deadline) {
+			g_set_error(
+				error,
+				GPLUGIN_DOMAIN,
+				0,
+				_("the unload budget of %u ms was exhausted before "
+				  "unloading: %s"),
+				timeout,
+				remaining->str);
+		} else {
+			g_set_error(
+				error,
+				GPLUGIN_DOMAIN,
+				0,
+				_("failed to unload: %s"),
+				remaining->str);
+		}
+
+		g_string_free(remaining, TRUE);
+
+		return FALSE;
+	}
+
+	g_string_free(remaining, TRUE);
+
+	return TRUE;
 }
 
 static gchar *
@@ -227,6 +483,144 @@ gplugin_manager_load_dependencies(
 	return all_loaded;
 }
 
+/* Emits the loading-plugin or unloading-plugin signal.  When nothing is
+ * connected to the signal, the class handler is called directly to avoid the
+ * cost of marshalling the emission.
+ */
+static gboolean
+gplugin_manager_emit_veto_signal(
+	GPluginManager *manager,
+	guint sig,
+	GPluginPlugin *plugin,
+	GError **error)
+{
+	GPluginManagerClass *klass = GPLUGIN_MANAGER_GET_CLASS(manager);
+	gboolean (*handler)(GPluginManager *, GPluginPlugin *, GError **) = NULL;
+	gboolean ret = TRUE;
+
+	if(g_signal_has_handler_pending(manager, signals[sig], 0, FALSE)) {
+		g_signal_emit(manager, signals[sig], 0, plugin, error, &ret);
+
+		return ret;
+	}
+
+	if(sig == SIG_LOADING) {
+		handler = klass->loading_plugin;
+	} else {
+		handler = klass->unloading_plugin;
+	}
+
+	if(handler != NULL) {
+		ret = handler(manager, plugin, error);
+	}
+
+	return ret;
+}
+
+/* Emits one of the signals that only take the plugin as an argument.  While a
+ * batch is in progress, loaded-plugin and unloaded-plugin are not emitted, and
+ * @plugin is instead added to the plugins-changed emission at the end of the
+ * batch.
+ */
+static void
+gplugin_manager_emit_plugin_signal(
+	GPluginManager *manager,
+	guint sig,
+	GPluginPlugin *plugin)
+{
+	GPluginManagerPrivate *priv = gplugin_manager_get_instance_private(manager);
+	GPluginManagerClass *klass = GPLUGIN_MANAGER_GET_CLASS(manager);
+	void (*handler)(GPluginManager *, GPluginPlugin *) = NULL;
+
+	if(priv->batch_depth > 0 &&
+	   (sig == SIG_LOADED || sig == SIG_UNLOADED)) {
+		return;
+	}
+
+	if(g_signal_has_handler_pending(manager, signals[sig], 0, FALSE)) {
+		g_signal_emit(manager, signals[sig], 0, plugin);
+
+		return;
+	}
+
+	switch(sig) {
+		case SIG_LOADED:
+			handler = klass->loaded_plugin;
+			break;
+		case SIG_LOAD_FAILED:
+			handler = klass->load_failed;
+			break;
+		case SIG_UNLOADED:
+			handler = klass->unloaded_plugin;
+			break;
+		case SIG_UNLOAD_FAILED:
+			handler = klass->unload_plugin_failed;
+			break;
+		default:
+			break;
+	}
+
+	if(handler != NULL) {
+		handler(manager, plugin);
+	}
+}
+
+/* Holds back notifications for @plugin if a batch is in progress and it isn't
+ * part of it already, so that multiple state changes result in a single
+ * notify::state and state-changed emission.  Returns %TRUE if a hold was taken,
+ * which must be passed to gplugin_manager_batch_finish() once the load or
+ * unload is done.
+ */
+static gboolean
+gplugin_manager_batch_hold(GPluginManager *manager, GPluginPlugin *plugin)
+{
+	GPluginManagerPrivate *priv = gplugin_manager_get_instance_private(manager);
+
+	if(priv->batch_depth == 0 ||
+	   g_hash_table_contains(priv->batch_plugins, plugin)) {
+		return FALSE;
+	}
+
+	g_object_freeze_notify(G_OBJECT(plugin));
+	gplugin_plugin_hold_state_changed(plugin);
+
+	return TRUE;
+}
+
+/* Releases the notifications held back for @plugin. */
+static void
+gplugin_manager_batch_release(GPluginPlugin *plugin)
+{
+	g_object_thaw_notify(G_OBJECT(plugin));
+	gplugin_plugin_release_state_changed(plugin);
+}
+
+/* Finishes a load or unload of @plugin that was started with
+ * gplugin_manager_batch_hold().  Only a successful load or unload adds @plugin
+ * to the batch; if it was vetoed or failed, the held notifications are
+ * released right away.  A plugin that was already part of the batch had no
+ * hold taken, and stays held until the batch ends either way.
+ */
+static void
+gplugin_manager_batch_finish(
+	GPluginManager *manager,
+	GPluginPlugin *plugin,
+	gboolean held,
+	gboolean success)
+{
+	GPluginManagerPrivate *priv = gplugin_manager_get_instance_private(manager);
+
+	if(!held) {
+		return;
+	}
+
+	if(success) {
+		g_hash_table_add(priv->batch_plugins, g_object_ref(G_OBJECT(plugin)));
+	} else {
+		gplugin_manager_batch_release(plugin);
+	}
+}
+
 /******************************************************************************
  * Manager implementation
  *****************************************************************************/
@@ -248,6 +642,211 @@ gplugin_manager_unloading_cb(
 	return TRUE;
 }
 
+static gint
+gplugin_manager_compare_proxy_priority(gconstpointer a, gconstpointer b)
+{
+	GPluginPluginInfo *info_a = NULL, *info_b = NULL;
+	gint priority_a = 0, priority_b = 0;
+
+	info_a = gplugin_plugin_proxy_get_info(GPLUGIN_PLUGIN_PROXY((gpointer)a));
+	info_b = gplugin_plugin_proxy_get_info(GPLUGIN_PLUGIN_PROXY((gpointer)b));
+
+	priority_a = gplugin_plugin_info_get_priority(info_a);
+	priority_b = gplugin_plugin_info_get_priority(info_b);
+
+	g_object_unref(G_OBJECT(info_a));
+	g_object_unref(G_OBJECT(info_b));
+
+	/* higher priorities go first */
+	if(priority_a > priority_b) {
+		return -1;
+	}
+
+	return (priority_a < priority_b) ? 1 : 0;
+}
+
+/******************************************************************************
+ * Query Helper
+ *****************************************************************************/
+static void
+gplugin_manager_query_cache_entry_free(gpointer data)
+{
+	GPluginManagerQueryCacheEntry *entry = data;
+
+	g_free(entry->message);
+	g_free(entry);
+}
+
+static gint64
+gplugin_manager_get_mtime(const gchar *filename)
+{
+	GStatBuf st;
+
+	if(g_stat(filename, &st) != 0) {
+		return -1;
+	}
+
+	return (gint64)st.st_mtime;
+}
+
+/* Returns the cached failure for filename if the file hasn't changed since
+ * the query helper choked on it.
+ */
+static GPluginManagerQueryCacheEntry *
+gplugin_manager_query_cache_lookup(
+	GPluginManager *manager,
+	const gchar *filename)
+{
+	GPluginManagerPrivate *priv = gplugin_manager_get_instance_private(manager);
+	GPluginManagerQueryCacheEntry *entry = NULL;
+
+	entry = g_hash_table_lookup(priv->query_cache, filename);
+	if(entry == NULL) {
+		return NULL;
+	}
+
+	if(entry->mtime != gplugin_manager_get_mtime(filename)) {
+		g_hash_table_remove(priv->query_cache, filename);
+
+		return NULL;
+	}
+
+	return entry;
+}
+
+/* The helper only has the native loader, so it needs to load the same native
+ * plugins that provided our other loaders.  Those are the native plugins that
+ * were loaded on query.
+ */
+static GList *
+gplugin_manager_get_loader_plugin_filenames(GPluginManager *manager)
+{
+	GPluginManagerPrivate *priv = gplugin_manager_get_instance_private(manager);
+	GHashTableIter iter;
+	GList *filenames = NULL;
+	gpointer key = NULL, value = NULL;
+
+	g_hash_table_iter_init(&iter, priv->plugins_filename_view);
+	while(g_hash_table_iter_next(&iter, &key, &value)) {
+		GPluginPlugin *plugin = GPLUGIN_PLUGIN(value);
+		GPluginPluginInfo *info = NULL;
+		GPluginLoader *loader = NULL;
+
+		if(gplugin_plugin_get_state(plugin) != GPLUGIN_PLUGIN_STATE_LOADED) {
+			continue;
+		}
+
+		loader = gplugin_plugin_get_loader(plugin);
+		info = gplugin_plugin_get_info(plugin);
+
+		if(loader == native_loader &&
+		   gplugin_plugin_info_get_load_on_query(info)) {
+			filenames = g_list_prepend(filenames, key);
+		}
+
+		g_clear_object(&loader);
+		g_clear_object(&info);
+	}
+
+	return filenames;
+}
+
+/* Runs every file in root that is about to be queried through the query
+ * helper and records the ones that crashed or hung it in the query cache.
+ * vetted holds the files that were already sent to the helper during this
+ * refresh so later passes only send the files that a new loader picked up.
+ */
+static void
+gplugin_manager_query_in_helper(
+	GPluginManager *manager,
+	GNode *root,
+	GHashTable *vetted)
+{
+	GPluginManagerPrivate *priv = gplugin_manager_get_instance_private(manager);
+	GHashTable *results = NULL;
+	GList *filenames = NULL, *loader_plugins = NULL, *l = NULL;
+	GNode *dir = NULL, *file = NULL;
+
+	for(dir = root->children; dir; dir = dir->next) {
+		GPluginFileTreeEntry *e = dir->data;
+		const gchar *path = e->filename;
+
+		for(file = dir->children; file; file = file->next) {
+			GPluginPlugin *plugin = NULL;
+			gchar *filename = NULL;
+
+			e = (GPluginFileTreeEntry *)file->data;
+
+			if(!g_hash_table_contains(
+				   priv->loaders_by_extension,
+				   e->extension)) {
+				continue;
+			}
+
+			filename = g_build_filename(path, e->filename, NULL);
+
+			plugin = g_hash_table_lookup(priv->plugins_filename_view, filename);
+			if(GPLUGIN_IS_PLUGIN(plugin)) {
+				GPluginPluginState state = gplugin_plugin_get_state(plugin);
+
+				if(state == GPLUGIN_PLUGIN_STATE_QUERIED ||
+				   state == GPLUGIN_PLUGIN_STATE_LOADED) {
+					g_free(filename);
+					continue;
+				}
+			}
+
+			if(g_hash_table_contains(vetted, filename) ||
+			   gplugin_manager_query_cache_lookup(manager, filename) != NULL) {
+				g_free(filename);
+				continue;
+			}
+
+			g_hash_table_add(vetted, g_strdup(filename));
+			filenames = g_list_prepend(filenames, filename);
+		}
+	}
+
+	if(filenames == NULL) {
+		return;
+	}
+
+	loader_plugins = gplugin_manager_get_loader_plugin_filenames(manager);
+
+	results = gplugin_query_sandbox_run(
+		loader_plugins,
+		filenames,
+		GPLUGIN_MANAGER_QUERY_TIMEOUT);
+
+	for(l = filenames; l != NULL; l = l->next) {
+		GPluginQuerySandboxResult *result = NULL;
+		GPluginManagerQueryCacheEntry *entry = NULL;
+
+		result = g_hash_table_lookup(results, l->data);
+
+		/* A clean error is fine to reproduce in process, it's only crashes
+		 * and hangs that we need to keep away from the application.  If the
+		 * helper never got as far as querying the file, we know nothing about
+		 * it, so it's queried in process like it would be without the
+		 * helper.
+		 */
+		if(result->status != GPLUGIN_QUERY_SANDBOX_STATUS_CRASHED &&
+		   result->status != GPLUGIN_QUERY_SANDBOX_STATUS_TIMED_OUT) {
+			continue;
+		}
+
+		entry = g_new0(GPluginManagerQueryCacheEntry, 1);
+		entry->mtime = gplugin_manager_get_mtime(l->data);
+		entry->message = g_strdup(result->message);
+
+		g_hash_table_replace(priv->query_cache, g_strdup(l->data), entry);
+	}
+
+	g_hash_table_destroy(results);
+	g_list_free(loader_plugins);
+	g_list_free_full(filenames, g_free);
+}
+
 /******************************************************************************
  * GObject Implementation
  *****************************************************************************/
@@ -256,15 +855,47 @@ gplugin_manager_finalize(GObject *obj)
 {
 	GPluginManager *manager = GPLUGIN_MANAGER(obj);
 	GPluginManagerPrivate *priv = gplugin_manager_get_instance_private(manager);
+	GHashTableIter iter;
+	GSList *loaded = NULL, *l = NULL;
+	GError *error = NULL;
+	gpointer key = NULL;
 
 	g_queue_free_full(priv->paths, g_free);
 	priv->paths = NULL;
 
-	/* unload all of the loaded plugins */
-	g_hash_table_foreach(
-		priv->plugins,
-		gplugin_manager_foreach_unload_plugin,
-		NULL);
+	/* unload all of the loaded plugins, dependents before their
+	 * dependencies.
+	 */
+	if(!gplugin_manager_unload_ordered(manager, FALSE, 0, 0, &error)) {
+		g_warning("%s", error->message);
+		g_clear_error(&error);
+	}
+
+	/* Whatever is still loaded is in a dependency cycle or depends on a plugin
+	 * that failed to unload.  There's no order left to respect, so unload it
+	 * anyway rather than leaving it loaded past the manager.
+	 */
+	loaded = gplugin_manager_find_plugins_with_state(
+		manager,
+		GPLUGIN_PLUGIN_STATE_LOADED);
+	for(l = loaded; l != NULL; l = l->next) {
+		GPluginPlugin *plugin = GPLUGIN_PLUGIN(l->data);
+		GPluginLoader *loader = gplugin_plugin_get_loader(plugin);
+
+		if(!gplugin_loader_unload_plugin(loader, plugin, &error)) {
+			GPluginPluginInfo *info = gplugin_plugin_get_info(plugin);
+
+			g_warning(
+				"failed to unload plugin with id %s: %s",
+				gplugin_plugin_info_get_id(info),
+				error ? error->message : "unknown");
+			g_clear_error(&error);
+
+			g_object_unref(G_OBJECT(info));
+		}
+		g_object_unref(G_OBJECT(loader));
+	}
+	g_slist_free_full(loaded, g_object_unref);
 
 	/* free all the data in the plugins hash table and destroy it */
 	g_hash_table_foreach_remove(
@@ -276,6 +907,17 @@ gplugin_manager_finalize(GObject *obj)
 	/* destroy the filename view */
 	g_clear_pointer(&priv->plugins_filename_view, g_hash_table_destroy);
 
+	/* release and destroy any batch that was never ended */
+	g_hash_table_iter_init(&iter, priv->batch_plugins);
+	while(g_hash_table_iter_next(&iter, &key, NULL)) {
+		gplugin_manager_batch_release(GPLUGIN_PLUGIN(key));
+	}
+	g_clear_pointer(&priv->batch_plugins, g_hash_table_destroy);
+
+	g_clear_pointer(&priv->query_cache, g_hash_table_destroy);
+
+	g_clear_pointer(&priv->proxies, g_hash_table_destroy);
+
 	/* clean up our list of loaders */
 	g_clear_pointer(&priv->loaders, g_hash_table_destroy);
 
@@ -426,6 +1068,31 @@ gplugin_manager_class_init(GPluginManagerClass *klass)
 		G_TYPE_NONE,
 		1,
 		G_TYPE_OBJECT);
+
+	/**
+	 * GPluginManager::plugins-changed:
+	 * @manager: The #GPluginManager instance.
+	 * @plugins: (element-type GPlugin.Plugin): A #GList of the #GPluginPlugin
+	 *           instances that were loaded or unloaded during the batch.
+	 *
+	 * Emitted by gplugin_manager_end_batch() when the outermost batch ends and
+	 * at least one plugin was loaded or unloaded during it.  This replaces the
+	 * #GPluginManager::loaded-plugin and #GPluginManager::unloaded-plugin
+	 * signals for the plugins in the batch.
+	 *
+	 * Since: 0.35.0
+	 */
+	signals[SIG_PLUGINS_CHANGED] = g_signal_new(
+		"plugins-changed",
+		G_OBJECT_CLASS_TYPE(manager_class),
+		G_SIGNAL_RUN_LAST,
+		G_STRUCT_OFFSET(GPluginManagerClass, plugins_changed),
+		NULL,
+		NULL,
+		NULL,
+		G_TYPE_NONE,
+		1,
+		G_TYPE_POINTER);
 }
 
 static void
@@ -466,6 +1133,33 @@ gplugin_manager_init(GPluginManager *manager)
 		g_str_equal,
 		g_free,
 		NULL);
+
+	/* the batch_plugins hash table is a set of the plugins that were loaded or
+	 * unloaded while a batch is in progress.
+	 */
+	priv->batch_plugins = g_hash_table_new_full(
+		g_direct_hash,
+		g_direct_equal,
+		g_object_unref,
+		NULL);
+
+	/* the query_cache hash table is keyed on the filenames that crashed or
+	 * hung the query helper with a GPluginManagerQueryCacheEntry as the value.
+	 */
+	priv->query_cache = g_hash_table_new_full(
+		g_str_hash,
+		g_str_equal,
+		g_free,
+		gplugin_manager_query_cache_entry_free);
+
+	/* the proxies hash table maps plugins to the GPluginPluginProxy that was
+	 * handed out for them, so that every caller gets the same proxy.
+	 */
+	priv->proxies = g_hash_table_new_full(
+		g_direct_hash,
+		g_direct_equal,
+		g_object_unref,
+		g_object_unref);
 }
 
 /******************************************************************************
@@ -506,9 +1200,34 @@ gplugin_manager_private_uninit(void)
 {
 	g_clear_object(&native_loader);
 
-	g_regex_unref(dependency_regex);
-
+	/* The manager needs the dependency regex to unload its plugins in order,
+	 * so it has to be destroyed first.
+	 */
 	g_clear_object(&default_manager);
+
+	g_clear_pointer(&dependency_regex, g_regex_unref);
+}
+
+/* Returns a new list with a reference to each loader registered for
+ * extension, in the order gplugin_manager_refresh() tries them.  Free it with
+ * g_slist_free_full() and g_object_unref().
+ */
+GSList *
+gplugin_manager_get_loaders_for_extension(
+	GPluginManager *manager,
+	const gchar *extension)
+{
+	GPluginManagerPrivate *priv = NULL;
+	GSList *loaders = NULL;
+
+	g_return_val_if_fail(GPLUGIN_IS_MANAGER(manager), NULL);
+	g_return_val_if_fail(extension != NULL, NULL);
+
+	priv = gplugin_manager_get_instance_private(manager);
+
+	loaders = g_hash_table_lookup(priv->loaders_by_extension, extension);
+
+	return g_slist_copy_deep(loaders, (GCopyFunc)g_object_ref, NULL);
 }
 
 /******************************************************************************
@@ -905,6 +1624,7 @@ gplugin_manager_refresh(GPluginManager *manager)
 {
 	GPluginManagerPrivate *priv = NULL;
 	GNode *root = NULL;
+	GHashTable *vetted = NULL;
 	GList *error_messages = NULL, *l = NULL;
 	gchar *error_message = NULL;
 	guint errors = 0;
@@ -916,6 +1636,10 @@ gplugin_manager_refresh(GPluginManager *manager)
 	/* build a tree of all possible plugins */
 	root = gplugin_file_tree_new(priv->paths->head);
 
+	if(gplugin_get_flags() & GPLUGIN_CORE_FLAGS_QUERY_IN_HELPER) {
+		vetted = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	}
+
 	priv->refresh_needed = TRUE;
 
 	while(priv->refresh_needed) {
@@ -930,6 +1654,10 @@ gplugin_manager_refresh(GPluginManager *manager)
 
 		priv->refresh_needed = FALSE;
 
+		if(vetted != NULL) {
+			gplugin_manager_query_in_helper(manager, root, vetted);
+		}
+
 		for(dir = root->children; dir; dir = dir->next) {
 			GPluginFileTreeEntry *e = dir->data;
 			GNode *file = NULL;
@@ -962,6 +1690,28 @@ gplugin_manager_refresh(GPluginManager *manager)
 					}
 				}
 
+				/* If the query helper couldn't survive querying this file,
+				 * neither would we, so skip it.
+				 */
+				if(vetted != NULL) {
+					GPluginManagerQueryCacheEntry *entry = NULL;
+
+					entry = gplugin_manager_query_cache_lookup(
+						manager,
+						filename);
+					if(entry != NULL) {
+						error_message = g_strdup_printf(
+							_("failed to query '%s' in the query helper: %s"),
+							filename,
+							entry->message);
+						error_messages =
+							g_list_prepend(error_messages, error_message);
+
+						g_free(filename);
+						continue;
+					}
+				}
+
 				/* grab the list of loaders for this extension */
 				l = g_hash_table_lookup(
 					priv->loaders_by_extension,
@@ -1128,6 +1878,8 @@ gplugin_manager_refresh(GPluginManager *manager)
 		g_list_free(error_messages);
 	}
 
+	g_clear_pointer(&vetted, g_hash_table_destroy);
+
 	/* free the file tree */
 	gplugin_file_tree_free(root);
 }
@@ -1418,6 +2170,101 @@ gplugin_manager_find_plugin_with_newest_version(
 	return plugin_a;
 }
 
+/**
+ * gplugin_manager_find_implementations:
+ * @manager: The #GPluginManager instance.
+ * @name: The name of the interface or extension point.
+ *
+ * Finds the plugins that list @name in #GPluginPluginInfo:implements and
+ * returns a #GPluginPluginProxy for each of them.  Only the newest plugin for
+ * each id is considered.
+ *
+ * None of the plugins are loaded by this function.  A plugin is only loaded
+ * when gplugin_plugin_proxy_activate() is called on its proxy, so plugins that
+ * are never used don't cost anything past being queried.  The same proxy is
+ * returned for a plugin every time.
+ *
+ * Returns: (element-type GPlugin.PluginProxy) (transfer full): A #GSList of
+ *          referenced #GPluginPluginProxy's sorted by the priority of their
+ *          plugins, highest first.  Call g_slist_free_full() with a
+ *          `DestroyNotify` of g_object_unref() on the returned value when
+ *          you're done with it.
+ *
+ * Since: 0.35.0
+ */
+GSList *
+gplugin_manager_find_implementations(
+	GPluginManager *manager,
+	const gchar *name)
+{
+	GPluginManagerPrivate *priv = NULL;
+	GSList *proxies = NULL;
+	GHashTableIter iter;
+	gpointer key = NULL;
+
+	g_return_val_if_fail(GPLUGIN_IS_MANAGER(manager), NULL);
+	g_return_val_if_fail(name != NULL, NULL);
+
+	priv = gplugin_manager_get_instance_private(manager);
+
+	g_hash_table_iter_init(&iter, priv->plugins);
+	while(g_hash_table_iter_next(&iter, &key, NULL)) {
+		GPluginPlugin *plugin = NULL;
+		GPluginPluginInfo *info = NULL;
+		GPluginPluginProxy *proxy = NULL;
+		const gchar *const *implements = NULL;
+		gboolean found = FALSE;
+		gint i = 0;
+
+		plugin = gplugin_manager_find_plugin_with_newest_version(
+			manager,
+			(const gchar *)key);
+		if(plugin == NULL) {
+			continue;
+		}
+
+		info = gplugin_plugin_get_info(plugin);
+
+		implements = gplugin_plugin_info_get_implements(info);
+		for(i = 0; implements != NULL && implements[i] != NULL; i++) {
+			if(g_str_equal(implements[i], name)) {
+				found = TRUE;
+				break;
+			}
+		}
+
+		g_object_unref(G_OBJECT(info));
+
+		if(!found) {
+			g_object_unref(G_OBJECT(plugin));
+
+			continue;
+		}
+
+		proxy = g_hash_table_lookup(priv->proxies, plugin);
+		if(proxy == NULL) {
+			/* clang-format off */
+			proxy = g_object_new(
+				GPLUGIN_TYPE_PLUGIN_PROXY,
+				"plugin", plugin,
+				"manager", manager,
+				NULL);
+			/* clang-format on */
+
+			g_hash_table_insert(
+				priv->proxies,
+				g_object_ref(G_OBJECT(plugin)),
+				proxy);
+		}
+
+		proxies = g_slist_prepend(proxies, g_object_ref(G_OBJECT(proxy)));
+
+		g_object_unref(G_OBJECT(plugin));
+	}
+
+	return g_slist_sort(proxies, gplugin_manager_compare_proxy_priority);
+}
+
 /**
  * gplugin_manager_get_plugin_dependencies:
  * @manager: The #GPluginManager instance.
@@ -1541,7 +2388,7 @@ gplugin_manager_load_plugin(
 	GPluginPluginInfo *info = NULL;
 	GPluginLoader *loader = NULL;
 	GError *real_error = NULL;
-	gboolean ret = TRUE;
+	gboolean ret = TRUE, held = FALSE;
 
 	g_return_val_if_fail(GPLUGIN_IS_MANAGER(manager), FALSE);
 	g_return_val_if_fail(GPLUGIN_IS_PLUGIN(plugin), FALSE);
@@ -1600,7 +2447,13 @@ gplugin_manager_load_plugin(
 		return FALSE;
 	}
 
-	g_signal_emit(manager, signals[SIG_LOADING], 0, plugin, &real_error, &ret);
+	held = gplugin_manager_batch_hold(manager, plugin);
+
+	ret = gplugin_manager_emit_veto_signal(
+		manager,
+		SIG_LOADING,
+		plugin,
+		&real_error);
 	if(!ret) {
 		/* Set the plugin's error. */
 		g_object_set(G_OBJECT(plugin), "error", real_error, NULL);
@@ -1608,17 +2461,19 @@ gplugin_manager_load_plugin(
 		g_propagate_error(error, real_error);
 
 		gplugin_plugin_set_state(plugin, GPLUGIN_PLUGIN_STATE_LOAD_FAILED);
+		gplugin_manager_batch_finish(manager, plugin, held, FALSE);
 		g_object_unref(G_OBJECT(loader));
 
 		return ret;
 	}
 
 	ret = gplugin_loader_load_plugin(loader, plugin, &real_error);
+	gplugin_manager_batch_finish(manager, plugin, held, ret);
 	if(ret) {
 		g_clear_error(&real_error);
-		g_signal_emit(manager, signals[SIG_LOADED], 0, plugin);
+		gplugin_manager_emit_plugin_signal(manager, SIG_LOADED, plugin);
 	} else {
-		g_signal_emit(manager, signals[SIG_LOAD_FAILED], 0, plugin);
+		gplugin_manager_emit_plugin_signal(manager, SIG_LOAD_FAILED, plugin);
 
 		g_propagate_error(error, real_error);
 	}
@@ -1647,7 +2502,7 @@ gplugin_manager_unload_plugin(
 {
 	GPluginLoader *loader = NULL;
 	GError *real_error = NULL;
-	gboolean ret = TRUE;
+	gboolean ret = TRUE, held = FALSE;
 
 	g_return_val_if_fail(GPLUGIN_IS_MANAGER(manager), FALSE);
 	g_return_val_if_fail(GPLUGIN_IS_PLUGIN(plugin), FALSE);
@@ -1668,13 +2523,13 @@ gplugin_manager_unload_plugin(
 		return FALSE;
 	}
 
-	g_signal_emit(
+	held = gplugin_manager_batch_hold(manager, plugin);
+
+	ret = gplugin_manager_emit_veto_signal(
 		manager,
-		signals[SIG_UNLOADING],
-		0,
+		SIG_UNLOADING,
 		plugin,
-		&real_error,
-		&ret);
+		&real_error);
 	if(!ret) {
 		/* Set the plugin's error. */
 		g_object_set(G_OBJECT(plugin), "error", real_error, NULL);
@@ -1682,17 +2537,19 @@ gplugin_manager_unload_plugin(
 		g_propagate_error(error, real_error);
 
 		gplugin_plugin_set_state(plugin, GPLUGIN_PLUGIN_STATE_LOAD_FAILED);
+		gplugin_manager_batch_finish(manager, plugin, held, FALSE);
 		g_object_unref(G_OBJECT(loader));
 
 		return ret;
 	}
 
 	ret = gplugin_loader_unload_plugin(loader, plugin, &real_error);
+	gplugin_manager_batch_finish(manager, plugin, held, ret);
 	if(ret) {
 		g_clear_error(&real_error);
-		g_signal_emit(manager, signals[SIG_UNLOADED], 0, plugin);
+		gplugin_manager_emit_plugin_signal(manager, SIG_UNLOADED, plugin);
 	} else {
-		g_signal_emit(manager, signals[SIG_UNLOAD_FAILED], 0, plugin);
+		gplugin_manager_emit_plugin_signal(manager, SIG_UNLOAD_FAILED, plugin);
 
 		g_propagate_error(error, real_error);
 	}
@@ -1702,6 +2559,140 @@ gplugin_manager_unload_plugin(
 	return ret;
 }
 
+/**
+ * gplugin_manager_unload_all:
+ * @manager: The #GPluginManager instance.
+ * @timeout: The time budget in milliseconds, or 0 for no limit.
+ * @plugin_timeout: The time limit for each plugin in milliseconds, or 0 for no
+ *                  limit.
+ * @error: (out) (nullable): Return location for a #GError or %NULL.
+ *
+ * Unloads every loaded plugin in reverse dependency order.  Plugins that no
+ * other loaded plugin depends on are unloaded first, and a plugin is only
+ * unloaded after everything that depends on it has been unloaded.  If a plugin
+ * fails to unload, the plugins it depends on are left loaded.
+ *
+ * If @timeout is non-zero, no more plugins are unloaded once it has elapsed,
+ * and a warning is logged for any plugin whose unload ran over it.  If
+ * @plugin_timeout is non-zero, a warning is logged for any plugin whose unload
+ * took longer than that on its own.  Plugins are unloaded in process, so a
+ * plugin that runs over either limit can't be interrupted and is still waited
+ * for.
+ *
+ * Returns: %TRUE if all plugins were unloaded, %FALSE otherwise with @error
+ *          set to a list of the plugins that are still loaded.
+ *
+ * Since: 0.35.0
+ */
+gboolean
+gplugin_manager_unload_all(
+	GPluginManager *manager,
+	guint timeout,
+	guint plugin_timeout,
+	GError **error)
+{
+	g_return_val_if_fail(GPLUGIN_IS_MANAGER(manager), FALSE);
+
+	return gplugin_manager_unload_ordered(
+		manager,
+		TRUE,
+		timeout,
+		plugin_timeout,
+		error);
+}
+
+/**
+ * gplugin_manager_begin_batch:
+ * @manager: The #GPluginManager instance.
+ *
+ * Starts a batch of plugin loads and unloads.  Until the matching call to
+ * gplugin_manager_end_batch(), @manager will not emit
+ * #GPluginManager::loaded-plugin or #GPluginManager::unloaded-plugin, and
+ * property notifications and #GPluginPlugin::state-changed for the plugins
+ * involved are held back.  A plugin that is not yet part of the batch gets its
+ * notifications right away if its load or unload was vetoed or failed, and
+ * stays out of the batch.  Once a plugin is part of the batch, everything up
+ * to gplugin_manager_end_batch() is held back, including failures.
+ *
+ * Batches can be nested, in which case only the outermost batch emits
+ * #GPluginManager::plugins-changed.
+ *
+ * Since: 0.35.0
+ */
+void
+gplugin_manager_begin_batch(GPluginManager *manager)
+{
+	GPluginManagerPrivate *priv = NULL;
+
+	g_return_if_fail(GPLUGIN_IS_MANAGER(manager));
+
+	priv = gplugin_manager_get_instance_private(manager);
+
+	priv->batch_depth++;
+}
+
+/**
+ * gplugin_manager_end_batch:
+ * @manager: The #GPluginManager instance.
+ *
+ * Ends a batch that was started with gplugin_manager_begin_batch().  If this
+ * ends the outermost batch, the held back property notifications and
+ * #GPluginPlugin::state-changed signals are emitted, and
+ * #GPluginManager::plugins-changed is emitted once with every plugin that was
+ * loaded or unloaded during the batch.
+ *
+ * Since: 0.35.0
+ */
+void
+gplugin_manager_end_batch(GPluginManager *manager)
+{
+	GPluginManagerPrivate *priv = NULL;
+	GPluginManagerClass *klass = NULL;
+	GHashTable *batch_plugins = NULL;
+	GList *plugins = NULL, *l = NULL;
+
+	g_return_if_fail(GPLUGIN_IS_MANAGER(manager));
+
+	priv = gplugin_manager_get_instance_private(manager);
+
+	g_return_if_fail(priv->batch_depth > 0);
+
+	priv->batch_depth--;
+	if(priv->batch_depth > 0) {
+		return;
+	}
+
+	/* swap the set out first in case a handler starts a new batch */
+	batch_plugins = priv->batch_plugins;
+	priv->batch_plugins = g_hash_table_new_full(
+		g_direct_hash,
+		g_direct_equal,
+		g_object_unref,
+		NULL);
+
+	plugins = g_hash_table_get_keys(batch_plugins);
+	for(l = plugins; l != NULL; l = l->next) {
+		gplugin_manager_batch_release(GPLUGIN_PLUGIN(l->data));
+	}
+
+	if(plugins != NULL) {
+		klass = GPLUGIN_MANAGER_GET_CLASS(manager);
+
+		if(g_signal_has_handler_pending(
+			   manager,
+			   signals[SIG_PLUGINS_CHANGED],
+			   0,
+			   FALSE)) {
+			g_signal_emit(manager, signals[SIG_PLUGINS_CHANGED], 0, plugins);
+		} else if(klass->plugins_changed != NULL) {
+			klass->plugins_changed(manager, plugins);
+		}
+	}
+
+	g_list_free(plugins);
+	g_hash_table_destroy(batch_plugins);
+}
+
 /**
  * gplugin_manager_list_plugins:
  * @manager: The #GPluginManager instance.
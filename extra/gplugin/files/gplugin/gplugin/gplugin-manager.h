@@ -26,6 +26,7 @@
 #include <glib-object.h>
 
 #include <gplugin/gplugin-plugin.h>
+#include <gplugin/gplugin-plugin-proxy.h>
 
 G_BEGIN_DECLS
 
@@ -61,9 +62,10 @@ struct _GPluginManagerClass {
 	void (*unloaded_plugin)(GPluginManager *manager, GPluginPlugin *plugin);
 	void (
 		*unload_plugin_failed)(GPluginManager *manager, GPluginPlugin *plugin);
+	void (*plugins_changed)(GPluginManager *manager, GList *plugins);
 
 	/*< private >*/
-	gpointer reserved[8];
+	gpointer reserved[7];
 };
 
 void gplugin_manager_append_path(GPluginManager *manager, const gchar *path);
@@ -113,6 +115,10 @@ GPluginPlugin *gplugin_manager_find_plugin_with_newest_version(
 	GPluginManager *manager,
 	const gchar *id);
 
+GSList *gplugin_manager_find_implementations(
+	GPluginManager *manager,
+	const gchar *name);
+
 GSList *gplugin_manager_get_plugin_dependencies(
 	GPluginManager *manager,
 	GPluginPlugin *plugin,
@@ -126,6 +132,14 @@ gboolean gplugin_manager_unload_plugin(
 	GPluginManager *manager,
 	GPluginPlugin *plugin,
 	GError **error);
+gboolean gplugin_manager_unload_all(
+	GPluginManager *manager,
+	guint timeout,
+	guint plugin_timeout,
+	GError **error);
+
+void gplugin_manager_begin_batch(GPluginManager *manager);
+void gplugin_manager_end_batch(GPluginManager *manager);
 
 GList *gplugin_manager_list_plugins(GPluginManager *manager);
 
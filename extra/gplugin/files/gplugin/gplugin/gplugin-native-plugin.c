@@ -145,8 +145,27 @@ struct _GPluginNativePlugin {
 	GPluginPluginInfo *info;
 	GPluginPluginState state;
 	GError *error;
+
+	/* the types registered with gplugin_native_plugin_register_type() keyed
+	 * on their names.
+	 */
+	GHashTable *types;
+	gboolean types_in_use;
+	guint n_type_registrations;
+	guint n_type_cache_hits;
 };
 
+/* A type registered with gplugin_native_plugin_register_type().  We wrap the
+ * class_init of the type so we can keep its class around once it has been
+ * created.
+ */
+typedef struct {
+	GType type;
+	GClassInitFunc class_init;
+	gconstpointer class_data;
+	GTypeClass *klass;
+} GPluginNativePluginType;
+
 /******************************************************************************
  * Enums
  *****************************************************************************/
@@ -167,6 +186,36 @@ static GParamSpec *properties[N_PROPERTIES] = {
 	NULL,
 };
 
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+gplugin_native_plugin_type_free(gpointer data)
+{
+	GPluginNativePluginType *type = data;
+
+	g_clear_pointer(&type->klass, g_type_class_unref);
+
+	g_free(type);
+}
+
+static void
+gplugin_native_plugin_type_class_init(gpointer klass, gpointer data)
+{
+	GPluginNativePluginType *type = data;
+
+	if(type->class_init != NULL) {
+		type->class_init(klass, (gpointer)type->class_data);
+	}
+
+	/* Hold on to the class so that it isn't finalized when the last instance
+	 * goes away, and more importantly isn't initialized again when the plugin
+	 * is reloaded.  GType supports taking a reference to a class during its
+	 * own initialization.
+	 */
+	type->klass = g_type_class_ref(type->type);
+}
+
 /******************************************************************************
  * GPluginPlugin Implementation
  *****************************************************************************/
@@ -300,14 +349,25 @@ gplugin_native_plugin_finalize(GObject *obj)
 	g_clear_object(&plugin->info);
 	g_clear_error(&plugin->error);
 
+	/* the classes need to go before the module that holds their code */
+	g_clear_pointer(&plugin->types, g_hash_table_destroy);
+	if(plugin->types_in_use) {
+		g_type_module_unuse(G_TYPE_MODULE(plugin));
+	}
+
 	g_module_close(plugin->module);
 
 	G_OBJECT_CLASS(gplugin_native_plugin_parent_class)->finalize(obj);
 }
 
 static void
-gplugin_native_plugin_init(G_GNUC_UNUSED GPluginNativePlugin *plugin)
+gplugin_native_plugin_init(GPluginNativePlugin *plugin)
 {
+	plugin->types = g_hash_table_new_full(
+		g_str_hash,
+		g_str_equal,
+		g_free,
+		gplugin_native_plugin_type_free);
 }
 
 static void
@@ -386,3 +446,119 @@ gplugin_native_plugin_get_module(GPluginNativePlugin *plugin)
 
 	return plugin->module;
 }
+
+/**
+ * gplugin_native_plugin_register_type:
+ * @plugin: #GPluginNativePlugin instance
+ * @parent: The type of the parent of the new type.
+ * @name: The name of the new type.
+ * @info: The #GTypeInfo for the new type.
+ * @flags: The #GTypeFlags for the new type.
+ *
+ * Registers a dynamic type for @plugin.  This is a replacement for
+ * g_type_module_register_type() that should be called from the load function
+ * of the plugin.
+ *
+ * Types registered with this function stay registered when @plugin is
+ * unloaded.  Calling this again for the same @name when @plugin is reloaded
+ * just returns the existing type.  The class of the type is still only
+ * initialized when it is first used, but it is kept after that so reloading
+ * @plugin does not run the class initializer again.
+ *
+ * Returns: The #GType of the new type or 0 on error.
+ *
+ * Since: 0.35.0
+ */
+GType
+gplugin_native_plugin_register_type(
+	GPluginNativePlugin *plugin,
+	GType parent,
+	const gchar *name,
+	const GTypeInfo *info,
+	GTypeFlags flags)
+{
+	GPluginNativePluginType *type = NULL;
+	GTypeInfo wrapped;
+
+	g_return_val_if_fail(GPLUGIN_IS_NATIVE_PLUGIN(plugin), G_TYPE_INVALID);
+	g_return_val_if_fail(name != NULL, G_TYPE_INVALID);
+	g_return_val_if_fail(info != NULL, G_TYPE_INVALID);
+
+	type = g_hash_table_lookup(plugin->types, name);
+	if(type != NULL) {
+		plugin->n_type_cache_hits++;
+
+		return type->type;
+	}
+
+	type = g_new0(GPluginNativePluginType, 1);
+	type->class_init = info->class_init;
+	type->class_data = info->class_data;
+
+	wrapped = *info;
+	wrapped.class_init = gplugin_native_plugin_type_class_init;
+	wrapped.class_data = type;
+
+	type->type = g_type_module_register_type(
+		G_TYPE_MODULE(plugin),
+		parent,
+		name,
+		&wrapped,
+		flags);
+	if(type->type == G_TYPE_INVALID) {
+		g_free(type);
+
+		return G_TYPE_INVALID;
+	}
+
+	plugin->n_type_registrations++;
+	g_hash_table_insert(plugin->types, g_strdup(name), type);
+
+	/* A GTypeModule expects its types to be registered again every time it
+	 * goes from unused to used.  Keeping it in use for as long as we're
+	 * around means the types we registered stay valid across reloads.
+	 */
+	if(!plugin->types_in_use) {
+		plugin->types_in_use = g_type_module_use(G_TYPE_MODULE(plugin));
+	}
+
+	return type->type;
+}
+
+/**
+ * gplugin_native_plugin_get_n_type_registrations:
+ * @plugin: #GPluginNativePlugin instance
+ *
+ * Gets the number of types that were actually registered with the type system
+ * by gplugin_native_plugin_register_type() for @plugin.
+ *
+ * Returns: The number of type registrations.
+ *
+ * Since: 0.35.0
+ */
+guint
+gplugin_native_plugin_get_n_type_registrations(GPluginNativePlugin *plugin)
+{
+	g_return_val_if_fail(GPLUGIN_IS_NATIVE_PLUGIN(plugin), 0);
+
+	return plugin->n_type_registrations;
+}
+
+/**
+ * gplugin_native_plugin_get_n_type_cache_hits:
+ * @plugin: #GPluginNativePlugin instance
+ *
+ * Gets the number of times gplugin_native_plugin_register_type() returned an
+ * already registered type for @plugin instead of registering it again.
+ *
+ * Returns: The number of cache hits.
+ *
+ * Since: 0.35.0
+ */
+guint
+gplugin_native_plugin_get_n_type_cache_hits(GPluginNativePlugin *plugin)
+{
+	g_return_val_if_fail(GPLUGIN_IS_NATIVE_PLUGIN(plugin), 0);
+
+	return plugin->n_type_cache_hits;
+}
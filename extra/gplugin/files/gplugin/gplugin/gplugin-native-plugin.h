@@ -49,6 +49,16 @@ typedef gboolean (*GPluginNativePluginUnloadFunc)(GPluginPlugin *plugin, GError
 
 GModule *gplugin_native_plugin_get_module(GPluginNativePlugin *plugin);
 
+GType gplugin_native_plugin_register_type(
+	GPluginNativePlugin *plugin,
+	GType parent,
+	const gchar *name,
+	const GTypeInfo *info,
+	GTypeFlags flags);
+guint gplugin_native_plugin_get_n_type_registrations(
+	GPluginNativePlugin *plugin);
+guint gplugin_native_plugin_get_n_type_cache_hits(GPluginNativePlugin *plugin);
+
 #define GPLUGIN_NATIVE_PLUGIN_DECLARE(name) \
 	G_MODULE_EXPORT GPluginPluginInfo *gplugin_query(GError **error); \
 	G_MODULE_EXPORT GPluginPluginInfo *gplugin_query(GError **error) \
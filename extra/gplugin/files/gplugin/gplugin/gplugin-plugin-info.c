@@ -73,6 +73,7 @@ typedef struct {
 	gchar *website;
 
 	gchar **dependencies;
+	gchar **implements;
 
 	guint32 abi_version;
 	gboolean internal;
@@ -105,6 +106,7 @@ enum {
 	PROP_AUTHORS,
 	PROP_WEBSITE,
 	PROP_DEPENDENCIES,
+	PROP_IMPLEMENTS,
 	N_PROPERTIES,
 };
 static GParamSpec *properties[N_PROPERTIES] = {
@@ -333,6 +335,19 @@ gplugin_plugin_info_set_dependencies(
 	priv->dependencies = g_strdupv((gchar **)dependencies);
 }
 
+static void
+gplugin_plugin_info_set_implements(
+	GPluginPluginInfo *info,
+	const gchar *const *implements)
+{
+	GPluginPluginInfoPrivate *priv =
+		gplugin_plugin_info_get_instance_private(info);
+
+	g_strfreev(priv->implements);
+
+	priv->implements = g_strdupv((gchar **)implements);
+}
+
 /******************************************************************************
  * Object Stuff
  *****************************************************************************/
@@ -415,6 +430,9 @@ gplugin_plugin_info_get_property(
 				value,
 				gplugin_plugin_info_get_dependencies(info));
 			break;
+		case PROP_IMPLEMENTS:
+			g_value_set_boxed(value, gplugin_plugin_info_get_implements(info));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 			break;
@@ -500,6 +518,9 @@ gplugin_plugin_info_set_property(
 				info,
 				g_value_get_boxed(value));
 			break;
+		case PROP_IMPLEMENTS:
+			gplugin_plugin_info_set_implements(info, g_value_get_boxed(value));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 			break;
@@ -525,6 +546,7 @@ gplugin_plugin_info_finalize(GObject *obj)
 	g_clear_pointer(&priv->authors, g_strfreev);
 	g_clear_pointer(&priv->website, g_free);
 	g_clear_pointer(&priv->dependencies, g_strfreev);
+	g_clear_pointer(&priv->implements, g_strfreev);
 	g_clear_pointer(&priv->category, g_free);
 
 	G_OBJECT_CLASS(gplugin_plugin_info_parent_class)->finalize(obj);
@@ -841,6 +863,25 @@ gplugin_plugin_info_class_init(GPluginPluginInfoClass *klass)
 		G_TYPE_STRV,
 		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT_ONLY);
 
+	/**
+	 * GPluginPluginInfo:implements:
+	 *
+	 * A list of the interfaces or extension points that this plugin
+	 * implements.  The names are defined by the application.
+	 *
+	 * Plugins that declare this can be found with
+	 * gplugin_manager_find_implementations() without being loaded, and are
+	 * only loaded when their #GPluginPluginProxy is activated.
+	 *
+	 * Since: 0.35.0
+	 */
+	properties[PROP_IMPLEMENTS] = g_param_spec_boxed(
+		"implements",
+		"implements",
+		"The interfaces or extension points the plugin implements",
+		G_TYPE_STRV,
+		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT_ONLY);
+
 	g_object_class_install_properties(obj_class, N_PROPERTIES, properties);
 }
 
@@ -1263,6 +1304,30 @@ gplugin_plugin_info_get_dependencies(GPluginPluginInfo *info)
 	return (const gchar *const *)priv->dependencies;
 }
 
+/**
+ * gplugin_plugin_info_get_implements:
+ * @info: The #GPluginPluginInfo instance.
+ *
+ * Returns the interfaces or extension points that the plugin implements as
+ * specified in @info.
+ *
+ * Returns: (array zero-terminated=1) (transfer none): The list of interfaces
+ *          or extension points from @info.
+ *
+ * Since: 0.35.0
+ */
+const gchar *const *
+gplugin_plugin_info_get_implements(GPluginPluginInfo *info)
+{
+	GPluginPluginInfoPrivate *priv = NULL;
+
+	g_return_val_if_fail(GPLUGIN_IS_PLUGIN_INFO(info), NULL);
+
+	priv = gplugin_plugin_info_get_instance_private(info);
+
+	return (const gchar *const *)priv->implements;
+}
+
 /**
  * gplugin_plugin_info_get_bind_global:
  * @info: The #GPluginPluginInfo instance.
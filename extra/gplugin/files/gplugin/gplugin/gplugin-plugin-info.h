@@ -74,6 +74,7 @@ const gchar *const *gplugin_plugin_info_get_authors(GPluginPluginInfo *info);
 const gchar *gplugin_plugin_info_get_website(GPluginPluginInfo *info);
 const gchar *const *gplugin_plugin_info_get_dependencies(
 	GPluginPluginInfo *info);
+const gchar *const *gplugin_plugin_info_get_implements(GPluginPluginInfo *info);
 gboolean gplugin_plugin_info_get_bind_global(GPluginPluginInfo *info);
 
 G_END_DECLS
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2011-2021 Gary Kramlich <grim@reaperworld.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gi18n-lib.h>
+
+#include <gplugin/gplugin-core.h>
+#include <gplugin/gplugin-manager.h>
+#include <gplugin/gplugin-plugin-proxy.h>
+
+/**
+ * SECTION:gplugin-plugin-proxy
+ * @Title: Plugin Proxies
+ * @Short_description: Stand-ins for plugins that haven't been loaded yet
+ *
+ * A #GPluginPluginProxy is handed out by
+ * gplugin_manager_find_implementations() for each plugin that implements an
+ * interface or extension point.  The information about the plugin is
+ * available right away, but the plugin itself is only loaded when the proxy is
+ * activated.  This lets an application know about every plugin that could
+ * handle something while only paying for the ones that it actually uses.
+ */
+
+/**
+ * GPLUGIN_TYPE_PLUGIN_PROXY:
+ *
+ * The standard _get_type macro for #GPluginPluginProxy.
+ */
+
+/**
+ * GPluginPluginProxy:
+ *
+ * #GPluginPluginProxy is an opaque data structure and should not be used
+ * directly.
+ */
+
+/******************************************************************************
+ * Structs
+ *****************************************************************************/
+struct _GPluginPluginProxy {
+	GObject parent;
+
+	GPluginPlugin *plugin;
+
+	/* the manager keeps its proxies around, so this is a weak pointer to
+	 * avoid a reference cycle.
+	 */
+	GPluginManager *manager;
+};
+
+/******************************************************************************
+ * Enums
+ *****************************************************************************/
+enum {
+	PROP_ZERO,
+	PROP_PLUGIN,
+	PROP_MANAGER,
+	N_PROPERTIES,
+};
+static GParamSpec *properties[N_PROPERTIES] = {
+	NULL,
+};
+
+G_DEFINE_TYPE(GPluginPluginProxy, gplugin_plugin_proxy, G_TYPE_OBJECT)
+
+/******************************************************************************
+ * GObject Implementation
+ *****************************************************************************/
+static void
+gplugin_plugin_proxy_get_property(
+	GObject *obj,
+	guint param_id,
+	GValue *value,
+	GParamSpec *pspec)
+{
+	GPluginPluginProxy *proxy = GPLUGIN_PLUGIN_PROXY(obj);
+
+	switch(param_id) {
+		case PROP_PLUGIN:
+			g_value_set_object(value, proxy->plugin);
+			break;
+		case PROP_MANAGER:
+			g_value_set_object(value, proxy->manager);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
+			break;
+	}
+}
+
+static void
+gplugin_plugin_proxy_set_property(
+	GObject *obj,
+	guint param_id,
+	const GValue *value,
+	GParamSpec *pspec)
+{
+	GPluginPluginProxy *proxy = GPLUGIN_PLUGIN_PROXY(obj);
+
+	switch(param_id) {
+		case PROP_PLUGIN:
+			proxy->plugin = g_value_dup_object(value);
+			break;
+		case PROP_MANAGER:
+			proxy->manager = g_value_get_object(value);
+			if(proxy->manager != NULL) {
+				g_object_add_weak_pointer(
+					G_OBJECT(proxy->manager),
+					(gpointer *)&proxy->manager);
+			}
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
+			break;
+	}
+}
+
+static void
+gplugin_plugin_proxy_finalize(GObject *obj)
+{
+	GPluginPluginProxy *proxy = GPLUGIN_PLUGIN_PROXY(obj);
+
+	g_clear_object(&proxy->plugin);
+
+	if(proxy->manager != NULL) {
+		g_object_remove_weak_pointer(
+			G_OBJECT(proxy->manager),
+			(gpointer *)&proxy->manager);
+		proxy->manager = NULL;
+	}
+
+	G_OBJECT_CLASS(gplugin_plugin_proxy_parent_class)->finalize(obj);
+}
+
+static void
+gplugin_plugin_proxy_init(G_GNUC_UNUSED GPluginPluginProxy *proxy)
+{
+}
+
+static void
+gplugin_plugin_proxy_class_init(GPluginPluginProxyClass *klass)
+{
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+
+	obj_class->get_property = gplugin_plugin_proxy_get_property;
+	obj_class->set_property = gplugin_plugin_proxy_set_property;
+	obj_class->finalize = gplugin_plugin_proxy_finalize;
+
+	/**
+	 * GPluginPluginProxy:plugin:
+	 *
+	 * The #GPluginPlugin that this proxy stands in for.
+	 *
+	 * Since: 0.35.0
+	 */
+	properties[PROP_PLUGIN] = g_param_spec_object(
+		"plugin",
+		"plugin",
+		"The plugin this proxy stands in for",
+		GPLUGIN_TYPE_PLUGIN,
+		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT_ONLY);
+
+	/**
+	 * GPluginPluginProxy:manager:
+	 *
+	 * The #GPluginManager that will load the plugin when this proxy is
+	 * activated.
+	 *
+	 * Since: 0.35.0
+	 */
+	properties[PROP_MANAGER] = g_param_spec_object(
+		"manager",
+		"manager",
+		"The manager that loads the plugin",
+		GPLUGIN_TYPE_MANAGER,
+		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT_ONLY);
+
+	g_object_class_install_properties(obj_class, N_PROPERTIES, properties);
+}
+
+/******************************************************************************
+ * API
+ *****************************************************************************/
+
+/**
+ * gplugin_plugin_proxy_get_info:
+ * @proxy: The #GPluginPluginProxy instance.
+ *
+ * Gets the #GPluginPluginInfo of the plugin behind @proxy without loading
+ * it.
+ *
+ * Returns: (transfer full): The #GPluginPluginInfo of the plugin.
+ *
+ * Since: 0.35.0
+ */
+GPluginPluginInfo *
+gplugin_plugin_proxy_get_info(GPluginPluginProxy *proxy)
+{
+	g_return_val_if_fail(GPLUGIN_IS_PLUGIN_PROXY(proxy), NULL);
+
+	return gplugin_plugin_get_info(proxy->plugin);
+}
+
+/**
+ * gplugin_plugin_proxy_get_activated:
+ * @proxy: The #GPluginPluginProxy instance.
+ *
+ * Checks whether the plugin behind @proxy is loaded.
+ *
+ * Returns: %TRUE if the plugin is loaded, %FALSE otherwise.
+ *
+ * Since: 0.35.0
+ */
+gboolean
+gplugin_plugin_proxy_get_activated(GPluginPluginProxy *proxy)
+{
+	g_return_val_if_fail(GPLUGIN_IS_PLUGIN_PROXY(proxy), FALSE);
+
+	return gplugin_plugin_get_state(proxy->plugin) ==
+	       GPLUGIN_PLUGIN_STATE_LOADED;
+}
+
+/**
+ * gplugin_plugin_proxy_activate:
+ * @proxy: The #GPluginPluginProxy instance.
+ * @error: (out) (nullable): The return address for a #GError.
+ *
+ * Loads the plugin behind @proxy with gplugin_manager_load_plugin() if it is
+ * not loaded yet and returns it.  This should be called right before the
+ * plugin is actually needed.
+ *
+ * Returns: (transfer full): The loaded #GPluginPlugin, or %NULL with @error
+ *          set if it could not be loaded.
+ *
+ * Since: 0.35.0
+ */
+GPluginPlugin *
+gplugin_plugin_proxy_activate(GPluginPluginProxy *proxy, GError **error)
+{
+	g_return_val_if_fail(GPLUGIN_IS_PLUGIN_PROXY(proxy), NULL);
+
+	if(!gplugin_plugin_proxy_get_activated(proxy)) {
+		if(!GPLUGIN_IS_MANAGER(proxy->manager)) {
+			g_set_error_literal(
+				error,
+				GPLUGIN_DOMAIN,
+				0,
+				_("the manager of this plugin proxy no longer exists"));
+
+			return NULL;
+		}
+
+		if(!gplugin_manager_load_plugin(proxy->manager, proxy->plugin, error)) {
+			return NULL;
+		}
+	}
+
+	return GPLUGIN_PLUGIN(g_object_ref(G_OBJECT(proxy->plugin)));
+}
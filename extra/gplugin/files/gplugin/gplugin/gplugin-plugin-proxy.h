@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2011-2021 Gary Kramlich <grim@reaperworld.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(GPLUGIN_GLOBAL_HEADER_INSIDE) && !defined(GPLUGIN_COMPILATION)
+#error "only <gplugin.h> may be included directly"
+#endif
+
+#ifndef GPLUGIN_PLUGIN_PROXY_H
+#define GPLUGIN_PLUGIN_PROXY_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include <gplugin/gplugin-plugin-info.h>
+#include <gplugin/gplugin-plugin.h>
+
+G_BEGIN_DECLS
+
+#define GPLUGIN_TYPE_PLUGIN_PROXY (gplugin_plugin_proxy_get_type())
+G_DECLARE_FINAL_TYPE(
+	GPluginPluginProxy,
+	gplugin_plugin_proxy,
+	GPLUGIN,
+	PLUGIN_PROXY,
+	GObject)
+
+GPluginPluginInfo *gplugin_plugin_proxy_get_info(GPluginPluginProxy *proxy);
+gboolean gplugin_plugin_proxy_get_activated(GPluginPluginProxy *proxy);
+GPluginPlugin *gplugin_plugin_proxy_activate(
+	GPluginPluginProxy *proxy,
+	GError **error);
+
+G_END_DECLS
+
+#endif /* GPLUGIN_PLUGIN_PROXY_H */
@@ -79,6 +79,45 @@ static guint signals[SIG_LAST] = {
 
 G_DEFINE_INTERFACE(GPluginPlugin, gplugin_plugin, G_TYPE_INVALID);
 
+/* While the manager has a plugin in a batch, state-changed is held back and
+ * emitted once with the state from before the first change when the hold is
+ * released.
+ */
+typedef struct {
+	guint depth;
+	gboolean changed;
+	GPluginPluginState oldstate;
+} GPluginPluginStateHold;
+
+G_DEFINE_QUARK(gplugin-plugin-state-hold, gplugin_plugin_state_hold);
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+gplugin_plugin_emit_state_changed(
+	GPluginPlugin *plugin,
+	GPluginPluginState oldstate,
+	GPluginPluginState state)
+{
+	/* If nothing is connected, call the class handler directly rather than
+	 * paying for the marshalling of an emission.
+	 */
+	if(g_signal_has_handler_pending(
+		   plugin,
+		   signals[SIG_STATE_CHANGED],
+		   0,
+		   FALSE)) {
+		g_signal_emit(plugin, signals[SIG_STATE_CHANGED], 0, oldstate, state);
+	} else {
+		GPluginPluginInterface *iface = GPLUGIN_PLUGIN_GET_IFACE(plugin);
+
+		if(iface->state_changed != NULL) {
+			iface->state_changed(plugin, oldstate, state);
+		}
+	}
+}
+
 /******************************************************************************
  * Object Stuff
  *****************************************************************************/
@@ -272,6 +311,7 @@ gplugin_plugin_get_state(GPluginPlugin *plugin)
 void
 gplugin_plugin_set_state(GPluginPlugin *plugin, GPluginPluginState state)
 {
+	GPluginPluginStateHold *hold = NULL;
 	GPluginPluginState oldstate = GPLUGIN_PLUGIN_STATE_UNKNOWN;
 
 	g_return_if_fail(GPLUGIN_IS_PLUGIN(plugin));
@@ -293,7 +333,19 @@ gplugin_plugin_set_state(GPluginPlugin *plugin, GPluginPluginState state)
 		g_clear_object(&info);
 	}
 
-	g_signal_emit(plugin, signals[SIG_STATE_CHANGED], 0, oldstate, state);
+	hold = g_object_get_qdata(
+		G_OBJECT(plugin),
+		gplugin_plugin_state_hold_quark());
+	if(hold != NULL) {
+		if(!hold->changed) {
+			hold->changed = TRUE;
+			hold->oldstate = oldstate;
+		}
+
+		return;
+	}
+
+	gplugin_plugin_emit_state_changed(plugin, oldstate, state);
 }
 
 /**
@@ -355,3 +407,76 @@ gplugin_plugin_state_to_string(GPluginPluginState state)
 
 	return state_str;
 }
+
+/******************************************************************************
+ * Private API
+ *****************************************************************************/
+
+/* Holds back #GPluginPlugin::state-changed for @plugin until the matching call
+ * to gplugin_plugin_release_state_changed().  Holds can be nested.
+ */
+void
+gplugin_plugin_hold_state_changed(GPluginPlugin *plugin)
+{
+	GPluginPluginStateHold *hold = NULL;
+
+	g_return_if_fail(GPLUGIN_IS_PLUGIN(plugin));
+
+	hold = g_object_get_qdata(
+		G_OBJECT(plugin),
+		gplugin_plugin_state_hold_quark());
+	if(hold == NULL) {
+		hold = g_new0(GPluginPluginStateHold, 1);
+		g_object_set_qdata_full(
+			G_OBJECT(plugin),
+			gplugin_plugin_state_hold_quark(),
+			hold,
+			g_free);
+	}
+
+	hold->depth++;
+}
+
+/* Releases a hold taken with gplugin_plugin_hold_state_changed().  When the
+ * last hold is released and the state changed while it was held,
+ * #GPluginPlugin::state-changed is emitted once from the state before the
+ * first change to the current state.
+ */
+void
+gplugin_plugin_release_state_changed(GPluginPlugin *plugin)
+{
+	GPluginPluginStateHold *hold = NULL;
+	GPluginPluginState oldstate = GPLUGIN_PLUGIN_STATE_UNKNOWN;
+	GPluginPluginState state = GPLUGIN_PLUGIN_STATE_UNKNOWN;
+	gboolean changed = FALSE;
+
+	g_return_if_fail(GPLUGIN_IS_PLUGIN(plugin));
+
+	hold = g_object_get_qdata(
+		G_OBJECT(plugin),
+		gplugin_plugin_state_hold_quark());
+	g_return_if_fail(hold != NULL);
+
+	hold->depth--;
+	if(hold->depth > 0) {
+		return;
+	}
+
+	changed = hold->changed;
+	oldstate = hold->oldstate;
+
+	/* this frees the hold */
+	g_object_set_qdata(
+		G_OBJECT(plugin),
+		gplugin_plugin_state_hold_quark(),
+		NULL);
+
+	if(!changed) {
+		return;
+	}
+
+	state = gplugin_plugin_get_state(plugin);
+	if(state != oldstate) {
+		gplugin_plugin_emit_state_changed(plugin, oldstate, state);
+	}
+}
@@ -25,6 +25,7 @@
  */
 #define GPLUGIN_GLOBAL_HEADER_INSIDE
 #include <gplugin/gplugin-plugin-info.h>
+#include <gplugin/gplugin-manager.h>
 #include <gplugin/gplugin-plugin.h>
 #undef GPLUGIN_GLOBAL_HEADER_INSIDE
 
@@ -32,6 +33,12 @@ G_BEGIN_DECLS
 
 void gplugin_manager_private_init(gboolean register_native_loader);
 void gplugin_manager_private_uninit(void);
+GSList *gplugin_manager_get_loaders_for_extension(
+	GPluginManager *manager,
+	const gchar *extension);
+
+void gplugin_plugin_hold_state_changed(GPluginPlugin *plugin);
+void gplugin_plugin_release_state_changed(GPluginPlugin *plugin);
 
 gboolean gplugin_boolean_accumulator(
 	GSignalInvocationHint *hint,
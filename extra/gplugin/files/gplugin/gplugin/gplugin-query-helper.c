@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2011-2021 Gary Kramlich <grim@reaperworld.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * gplugin-query-helper is spawned by the manager when GPlugin was initialized
+ * with GPLUGIN_CORE_FLAGS_QUERY_IN_HELPER.  It queries the files it was given
+ * and reports the results on stdout.  See gplugin-query-sandbox.c for the
+ * protocol.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include <gplugin.h>
+
+#include <gplugin/gplugin-private.h>
+
+/******************************************************************************
+ * Globals
+ *****************************************************************************/
+static gchar **loader_plugins = NULL;
+static gchar **filenames = NULL;
+static FILE *output = NULL;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+/* Queries filename with each loader registered for its extension until one
+ * returns a plugin, the same way gplugin_manager_refresh() does, so the verdict
+ * matches what the manager would get in process.
+ */
+static GPluginPlugin *
+query_plugin(GPluginManager *manager, const gchar *filename, GError **error)
+{
+	GPluginPlugin *plugin = NULL;
+	GSList *loaders = NULL, *l = NULL;
+	const gchar *extension = NULL;
+
+	extension = strrchr(filename, '.');
+	if(extension != NULL) {
+		loaders =
+			gplugin_manager_get_loaders_for_extension(manager, extension + 1);
+	}
+
+	if(loaders == NULL) {
+		g_set_error_literal(error, GPLUGIN_DOMAIN, 0, _("no loader found"));
+
+		return NULL;
+	}
+
+	for(l = loaders; l != NULL; l = l->next) {
+		GPluginLoader *loader = GPLUGIN_LOADER(l->data);
+
+		/* only the error from the last loader we tried is reported */
+		g_clear_error(error);
+
+		plugin = gplugin_loader_query_plugin(loader, filename, error);
+		if(GPLUGIN_IS_PLUGIN(plugin)) {
+			g_clear_error(error);
+
+			break;
+		}
+
+		g_clear_object(&plugin);
+	}
+	g_slist_free_full(loaders, g_object_unref);
+
+	return plugin;
+}
+
+static void
+write_line(const gchar *type, const gchar *filename, const gchar *payload)
+{
+	gchar *escaped_filename = g_strescape(filename, NULL);
+
+	if(payload != NULL) {
+		gchar *escaped_payload = g_strescape(payload, NULL);
+
+		fprintf(output, "%s\t%s\t%s\n", type, escaped_filename, escaped_payload);
+
+		g_free(escaped_payload);
+	} else {
+		fprintf(output, "%s\t%s\n", type, escaped_filename);
+	}
+
+	/* the manager is waiting on every line, so don't let them sit around */
+	fflush(output);
+
+	g_free(escaped_filename);
+}
+
+static void
+load_loader_plugins(GPluginManager *manager)
+{
+	GPluginLoader *native = NULL;
+	GList *loaders = NULL, *l = NULL;
+	gint i = 0;
+
+	if(loader_plugins == NULL) {
+		return;
+	}
+
+	loaders = gplugin_manager_get_loaders(manager);
+	for(l = loaders; l != NULL; l = l->next) {
+		if(g_str_equal(gplugin_loader_get_id(l->data), "gplugin-native")) {
+			native = GPLUGIN_LOADER(l->data);
+		}
+	}
+	g_list_free(loaders);
+
+	if(native == NULL) {
+		g_warning("the native loader is not registered");
+
+		return;
+	}
+
+	for(i = 0; loader_plugins[i] != NULL; i++) {
+		GPluginPlugin *plugin = NULL;
+		GError *error = NULL;
+
+		plugin = gplugin_loader_query_plugin(native, loader_plugins[i], &error);
+		if(plugin == NULL) {
+			g_warning(
+				"failed to query loader plugin %s: %s",
+				loader_plugins[i],
+				error ? error->message : "unknown");
+			g_clear_error(&error);
+
+			continue;
+		}
+
+		/* loader plugins can't be unloaded, so we just keep the reference
+		 * until we exit.
+		 */
+		if(!gplugin_loader_load_plugin(native, plugin, &error)) {
+			g_warning(
+				"failed to load loader plugin %s: %s",
+				loader_plugins[i],
+				error ? error->message : "unknown");
+			g_clear_error(&error);
+		}
+	}
+}
+
+/******************************************************************************
+ * Main Stuff
+ *****************************************************************************/
+/* clang-format off */
+static GOptionEntry entries[] = {
+	{
+		"loader-plugin", 'l', 0, G_OPTION_ARG_FILENAME_ARRAY,
+		&loader_plugins, N_("Load a plugin that provides a loader"),
+		N_("FILENAME"),
+	}, {
+		G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY,
+		&filenames, NULL,
+		NULL,
+	}, {
+		NULL, 0, 0, 0, NULL, NULL, NULL,
+	}
+};
+/* clang-format on */
+
+gint
+main(gint argc, gchar **argv)
+{
+	GPluginManager *manager = NULL;
+	GOptionContext *ctx = NULL;
+	GError *error = NULL;
+	gint i = 0;
+
+	ctx = g_option_context_new("FILENAME...");
+	g_option_context_set_summary(
+		ctx,
+		_("Query plugins on behalf of the GPlugin manager"));
+	g_option_context_set_translation_domain(ctx, GETTEXT_PACKAGE);
+	g_option_context_add_main_entries(ctx, entries, NULL);
+
+	g_option_context_parse(ctx, &argc, &argv, &error);
+	g_option_context_free(ctx);
+
+	if(error) {
+		fprintf(stderr, "%s\n", error->message);
+
+		g_error_free(error);
+
+		return EXIT_FAILURE;
+	}
+
+	/* Plugins are free to print whatever they want while being queried, so
+	 * keep the real stdout for ourselves and point theirs at stderr.
+	 */
+#ifdef G_OS_UNIX
+	output = fdopen(dup(STDOUT_FILENO), "w");
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+#endif
+	if(output == NULL) {
+		output = stdout;
+	}
+
+	gplugin_init(GPLUGIN_CORE_FLAGS_NONE);
+
+	manager = gplugin_manager_get_default();
+
+	load_loader_plugins(manager);
+
+	for(i = 0; filenames != NULL && filenames[i] != NULL; i++) {
+		GPluginPlugin *plugin = NULL;
+
+		write_line("query", filenames[i], NULL);
+
+		plugin = query_plugin(manager, filenames[i], &error);
+		if(GPLUGIN_IS_PLUGIN(plugin)) {
+			write_line("ok", filenames[i], NULL);
+
+			g_object_unref(G_OBJECT(plugin));
+		} else {
+			write_line(
+				"error",
+				filenames[i],
+				(error != NULL) ? error->message : _("unknown error"));
+			g_clear_error(&error);
+		}
+	}
+
+	fclose(output);
+
+	g_strfreev(loader_plugins);
+	g_strfreev(filenames);
+
+	gplugin_uninit();
+
+	return 0;
+}
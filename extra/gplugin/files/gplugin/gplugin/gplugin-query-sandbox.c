@@ -0,0 +1,457 @@
+/*
+ * Copyright (C) 2011-2021 Gary Kramlich <grim@reaperworld.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gio/gio.h>
+#include <glib/gi18n-lib.h>
+
+#include <gplugin/gplugin-query-sandbox.h>
+
+/*
+ * The query sandbox runs loader queries in a pool of gplugin-query-helper
+ * processes so that a plugin that crashes or hangs while being queried can't
+ * take the application down with it.  It only screens files; the ones that
+ * survive are queried again in process by the manager, since a plugin
+ * object can't be carried across the process boundary.
+ *
+ * Each helper is passed the plugins that provide loaders followed by the
+ * files to query, and writes one line per event to its stdout, with every
+ * field escaped with g_strescape():
+ *
+ *   query <TAB> filename
+ *   ok <TAB> filename
+ *   error <TAB> filename <TAB> error message
+ *
+ * A query line is written before each query starts, so if the helper exits or
+ * has to be killed before the matching result line, we know which file was
+ * responsible.  A new helper is then spawned for the files that are left.
+ *
+ * If the helper can't be spawned, or fails before it starts its first query,
+ * no file is to blame and the remaining files are reported as not started.
+ */
+
+/******************************************************************************
+ * Structs
+ *****************************************************************************/
+typedef struct {
+	GList *loader_plugins;
+	guint timeout;
+
+	GMainContext *context;
+	GHashTable *results;
+	guint running;
+} GPluginQuerySandbox;
+
+typedef struct {
+	GPluginQuerySandbox *sandbox;
+
+	GSubprocess *subprocess;
+	GDataInputStream *stream;
+	GSource *timeout_source;
+
+	GQueue *pending;
+	gchar *current;
+	gboolean started;
+} GPluginQuerySandboxWorker;
+
+/******************************************************************************
+ * Prototypes
+ *****************************************************************************/
+static void gplugin_query_sandbox_worker_spawn(
+	GPluginQuerySandboxWorker *worker);
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+gplugin_query_sandbox_result_free(gpointer data)
+{
+	GPluginQuerySandboxResult *result = (GPluginQuerySandboxResult *)data;
+
+	g_free(result->message);
+	g_free(result);
+}
+
+static void
+gplugin_query_sandbox_add_result(
+	GPluginQuerySandbox *sandbox,
+	const gchar *filename,
+	GPluginQuerySandboxStatus status,
+	const gchar *message)
+{
+	GPluginQuerySandboxResult *result = g_new0(GPluginQuerySandboxResult, 1);
+
+	result->status = status;
+	result->message = g_strdup(message);
+
+	g_hash_table_replace(sandbox->results, g_strdup(filename), result);
+}
+
+static void
+gplugin_query_sandbox_worker_stop_timeout(GPluginQuerySandboxWorker *worker)
+{
+	if(worker->timeout_source != NULL) {
+		g_source_destroy(worker->timeout_source);
+		g_clear_pointer(&worker->timeout_source, g_source_unref);
+	}
+}
+
+static gboolean
+gplugin_query_sandbox_worker_timeout_cb(gpointer data)
+{
+	GPluginQuerySandboxWorker *worker = (GPluginQuerySandboxWorker *)data;
+	GPluginQuerySandbox *sandbox = worker->sandbox;
+
+	g_clear_pointer(&worker->timeout_source, g_source_unref);
+
+	if(worker->current != NULL) {
+		gplugin_query_sandbox_add_result(
+			sandbox,
+			worker->current,
+			GPLUGIN_QUERY_SANDBOX_STATUS_TIMED_OUT,
+			_("the query did not finish in time"));
+		g_clear_pointer(&worker->current, g_free);
+	} else if(!worker->started) {
+		gchar *filename = NULL;
+
+		/* The helper hung before it started querying, which means one of the
+		 * loader plugins is the problem.  Respawning would just hang again, so
+		 * give up on everything this worker had left.
+		 */
+		while((filename = g_queue_pop_head(worker->pending)) != NULL) {
+			gplugin_query_sandbox_add_result(
+				sandbox,
+				filename,
+				GPLUGIN_QUERY_SANDBOX_STATUS_NOT_STARTED,
+				_("the query helper did not start in time"));
+			g_free(filename);
+		}
+	}
+
+	/* If the helper stalled between a result and the next query, no file is
+	 * to blame, so just kill it and let the respawn pick up the rest.
+	 *
+	 * Killing the helper will close its stdout, which finishes the pending
+	 * read and lets the read callback clean up or respawn.
+	 */
+	g_subprocess_force_exit(worker->subprocess);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+gplugin_query_sandbox_worker_start_timeout(GPluginQuerySandboxWorker *worker)
+{
+	gplugin_query_sandbox_worker_stop_timeout(worker);
+
+	worker->timeout_source = g_timeout_source_new(worker->sandbox->timeout);
+	g_source_set_callback(
+		worker->timeout_source,
+		gplugin_query_sandbox_worker_timeout_cb,
+		worker,
+		NULL);
+	g_source_attach(worker->timeout_source, worker->sandbox->context);
+}
+
+static void
+gplugin_query_sandbox_worker_handle_line(
+	GPluginQuerySandboxWorker *worker,
+	const gchar *line)
+{
+	GPluginQuerySandbox *sandbox = worker->sandbox;
+	gchar **fields = NULL;
+	gchar *filename = NULL, *payload = NULL;
+
+	fields = g_strsplit(line, "\t", 3);
+	if(fields[0] == NULL || fields[1] == NULL) {
+		g_strfreev(fields);
+
+		return;
+	}
+
+	filename = g_strcompress(fields[1]);
+	if(fields[2] != NULL) {
+		payload = g_strcompress(fields[2]);
+	}
+
+	if(g_str_equal(fields[0], "query")) {
+		/* the helper works through the files in the order we gave them */
+		g_free(g_queue_pop_head(worker->pending));
+
+		g_free(worker->current);
+		worker->current = g_strdup(filename);
+		worker->started = TRUE;
+
+		gplugin_query_sandbox_worker_start_timeout(worker);
+	} else if(g_str_equal(fields[0], "ok")) {
+		gplugin_query_sandbox_add_result(
+			sandbox,
+			filename,
+			GPLUGIN_QUERY_SANDBOX_STATUS_OK,
+			NULL);
+
+		g_clear_pointer(&worker->current, g_free);
+	} else if(g_str_equal(fields[0], "error")) {
+		gplugin_query_sandbox_add_result(
+			sandbox,
+			filename,
+			GPLUGIN_QUERY_SANDBOX_STATUS_ERROR,
+			payload);
+
+		g_clear_pointer(&worker->current, g_free);
+	}
+
+	/* a result restarts the timer so it covers the gap up to the next query
+	 * line instead of whatever was left over from the last query.
+	 */
+	if(worker->current == NULL) {
+		gplugin_query_sandbox_worker_start_timeout(worker);
+	}
+
+	g_free(filename);
+	g_free(payload);
+	g_strfreev(fields);
+}
+
+static void
+gplugin_query_sandbox_worker_read_cb(
+	GObject *source,
+	GAsyncResult *res,
+	gpointer data)
+{
+	GPluginQuerySandboxWorker *worker = (GPluginQuerySandboxWorker *)data;
+	GPluginQuerySandbox *sandbox = worker->sandbox;
+	gchar *line = NULL;
+
+	line = g_data_input_stream_read_line_finish_utf8(
+		G_DATA_INPUT_STREAM(source),
+		res,
+		NULL,
+		NULL);
+
+	if(line != NULL) {
+		gplugin_query_sandbox_worker_handle_line(worker, line);
+		g_free(line);
+
+		g_data_input_stream_read_line_async(
+			worker->stream,
+			G_PRIORITY_DEFAULT,
+			NULL,
+			gplugin_query_sandbox_worker_read_cb,
+			worker);
+
+		return;
+	}
+
+	/* The helper is gone, either because it finished, crashed, or we killed
+	 * it.
+	 */
+	gplugin_query_sandbox_worker_stop_timeout(worker);
+	g_subprocess_force_exit(worker->subprocess);
+	g_clear_object(&worker->stream);
+	g_clear_object(&worker->subprocess);
+
+	if(worker->current != NULL) {
+		gplugin_query_sandbox_add_result(
+			sandbox,
+			worker->current,
+			GPLUGIN_QUERY_SANDBOX_STATUS_CRASHED,
+			_("the query helper exited during the query"));
+		g_clear_pointer(&worker->current, g_free);
+	}
+
+	sandbox->running--;
+
+	if(g_queue_is_empty(worker->pending)) {
+		return;
+	}
+
+	/* If the helper died before it started a single query, it's failing on
+	 * the loader plugins and a new one would fail the same way.
+	 */
+	if(!worker->started) {
+		gchar *filename = NULL;
+
+		while((filename = g_queue_pop_head(worker->pending)) != NULL) {
+			gplugin_query_sandbox_add_result(
+				sandbox,
+				filename,
+				GPLUGIN_QUERY_SANDBOX_STATUS_NOT_STARTED,
+				_("the query helper exited before querying the plugin"));
+			g_free(filename);
+		}
+
+		return;
+	}
+
+	gplugin_query_sandbox_worker_spawn(worker);
+}
+
+static void
+gplugin_query_sandbox_worker_spawn(GPluginQuerySandboxWorker *worker)
+{
+	GPluginQuerySandbox *sandbox = worker->sandbox;
+	GPtrArray *argv = NULL;
+	GList *l = NULL;
+	GError *error = NULL;
+
+	argv = g_ptr_array_new();
+	g_ptr_array_add(argv, (gpointer)gplugin_query_sandbox_get_helper());
+	for(l = sandbox->loader_plugins; l != NULL; l = l->next) {
+		g_ptr_array_add(argv, "--loader-plugin");
+		g_ptr_array_add(argv, l->data);
+	}
+	g_ptr_array_add(argv, "--");
+	for(l = worker->pending->head; l != NULL; l = l->next) {
+		g_ptr_array_add(argv, l->data);
+	}
+	g_ptr_array_add(argv, NULL);
+
+	worker->subprocess = g_subprocess_newv(
+		(const gchar *const *)argv->pdata,
+		G_SUBPROCESS_FLAGS_STDOUT_PIPE,
+		&error);
+	g_ptr_array_free(argv, TRUE);
+
+	if(worker->subprocess == NULL) {
+		gchar *filename = NULL;
+
+		while((filename = g_queue_pop_head(worker->pending)) != NULL) {
+			gplugin_query_sandbox_add_result(
+				sandbox,
+				filename,
+				GPLUGIN_QUERY_SANDBOX_STATUS_NOT_STARTED,
+				error->message);
+			g_free(filename);
+		}
+
+		g_error_free(error);
+
+		return;
+	}
+
+	worker->started = FALSE;
+	worker->stream = g_data_input_stream_new(
+		g_subprocess_get_stdout_pipe(worker->subprocess));
+
+	sandbox->running++;
+
+	/* the timeout also covers loading the loader plugins */
+	gplugin_query_sandbox_worker_start_timeout(worker);
+
+	g_data_input_stream_read_line_async(
+		worker->stream,
+		G_PRIORITY_DEFAULT,
+		NULL,
+		gplugin_query_sandbox_worker_read_cb,
+		worker);
+}
+
+/******************************************************************************
+ * Private API
+ *****************************************************************************/
+
+/* Returns the path of the gplugin-query-helper binary.  The GPLUGIN_QUERY_HELPER
+ * environment variable can be used to override it, which the unit tests use to
+ * run the uninstalled helper.
+ */
+const gchar *
+gplugin_query_sandbox_get_helper(void)
+{
+	const gchar *helper = g_getenv("GPLUGIN_QUERY_HELPER");
+
+	if(helper != NULL && *helper != '\0') {
+		return helper;
+	}
+
+	return GPLUGIN_QUERY_HELPER;
+}
+
+/* Queries filenames in a pool of helper processes, waiting at most timeout
+ * milliseconds for each query.  loader_plugins are the filenames of native
+ * plugins that need to be loaded in each helper for it to have the same
+ * loaders as the calling process.
+ *
+ * Returns a hash table of filename to GPluginQuerySandboxResult with an entry
+ * for every filename.
+ */
+GHashTable *
+gplugin_query_sandbox_run(GList *loader_plugins, GList *filenames, guint timeout)
+{
+	GPluginQuerySandbox sandbox = {
+		.loader_plugins = loader_plugins,
+		.timeout = timeout,
+	};
+	GPluginQuerySandboxWorker *workers = NULL;
+	GList *l = NULL;
+	guint n_workers = 0, i = 0;
+
+	sandbox.results = g_hash_table_new_full(
+		g_str_hash,
+		g_str_equal,
+		g_free,
+		gplugin_query_sandbox_result_free);
+
+	n_workers = MIN(g_get_num_processors(), g_list_length(filenames));
+	if(n_workers == 0) {
+		return sandbox.results;
+	}
+
+	sandbox.context = g_main_context_new();
+	g_main_context_push_thread_default(sandbox.context);
+
+	workers = g_new0(GPluginQuerySandboxWorker, n_workers);
+	for(i = 0; i < n_workers; i++) {
+		workers[i].sandbox = &sandbox;
+		workers[i].pending = g_queue_new();
+	}
+
+	/* hand out the files round robin so slow plugins that sit next to each
+	 * other on disk end up in different workers.
+	 */
+	for(l = filenames, i = 0; l != NULL; l = l->next, i++) {
+		g_queue_push_tail(workers[i % n_workers].pending, g_strdup(l->data));
+	}
+
+	for(i = 0; i < n_workers; i++) {
+		gplugin_query_sandbox_worker_spawn(&workers[i]);
+	}
+
+	while(sandbox.running > 0) {
+		g_main_context_iteration(sandbox.context, TRUE);
+	}
+
+	for(i = 0; i < n_workers; i++) {
+		g_queue_free_full(workers[i].pending, g_free);
+	}
+	g_free(workers);
+
+	g_main_context_pop_thread_default(sandbox.context);
+	g_main_context_unref(sandbox.context);
+
+	/* anything a helper never got to wasn't its fault */
+	for(l = filenames; l != NULL; l = l->next) {
+		if(!g_hash_table_contains(sandbox.results, l->data)) {
+			gplugin_query_sandbox_add_result(
+				&sandbox,
+				l->data,
+				GPLUGIN_QUERY_SANDBOX_STATUS_NOT_STARTED,
+				_("the query helper exited without querying the plugin"));
+		}
+	}
+
+	return sandbox.results;
+}
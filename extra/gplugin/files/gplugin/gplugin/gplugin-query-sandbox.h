@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2011-2021 Gary Kramlich <grim@reaperworld.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GPLUGIN_QUERY_SANDBOX_H
+#define GPLUGIN_QUERY_SANDBOX_H
+
+#include <glib.h>
+
+typedef enum {
+	GPLUGIN_QUERY_SANDBOX_STATUS_OK,
+	GPLUGIN_QUERY_SANDBOX_STATUS_ERROR,
+	GPLUGIN_QUERY_SANDBOX_STATUS_CRASHED,
+	GPLUGIN_QUERY_SANDBOX_STATUS_TIMED_OUT,
+	GPLUGIN_QUERY_SANDBOX_STATUS_NOT_STARTED,
+} GPluginQuerySandboxStatus;
+
+typedef struct {
+	GPluginQuerySandboxStatus status;
+
+	/* a description of the failure for any status other than OK */
+	gchar *message;
+} GPluginQuerySandboxResult;
+
+G_BEGIN_DECLS
+
+const gchar *gplugin_query_sandbox_get_helper(void);
+
+GHashTable *gplugin_query_sandbox_run(
+	GList *loader_plugins,
+	GList *filenames,
+	guint timeout);
+
+G_END_DECLS
+
+#endif /* GPLUGIN_QUERY_SANDBOX_H */
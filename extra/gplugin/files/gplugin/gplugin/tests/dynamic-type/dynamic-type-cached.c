@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2011-2021 Gary Kramlich <grim@reaperworld.com>
+ * Copyright (C) 2013 Ankit Vani <a@nevitus.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gplugin.h>
+#include <gplugin-native.h>
+
+/* This plugin registers its type with gplugin_native_plugin_register_type()
+ * and counts how often its class is initialized in the type's qdata so the
+ * test can check that reloading doesn't initialize it again.
+ */
+
+static void
+dynamic_cached_class_init(gpointer klass, G_GNUC_UNUSED gpointer data)
+{
+	GType type = G_TYPE_FROM_CLASS(klass);
+	GQuark quark = g_quark_from_static_string("class-init-count");
+	guint count = GPOINTER_TO_UINT(g_type_get_qdata(type, quark));
+
+	g_type_set_qdata(type, quark, GUINT_TO_POINTER(count + 1));
+}
+
+static GPluginPluginInfo *
+dynamic_cached_query(G_GNUC_UNUSED GError **error)
+{
+	return gplugin_plugin_info_new(
+		"gplugin/dynamic-type-cached",
+		GPLUGIN_NATIVE_PLUGIN_ABI_VERSION,
+		NULL);
+}
+
+static gboolean
+dynamic_cached_load(GPluginPlugin *plugin, GError **error)
+{
+	const GTypeInfo info = {
+		.class_size = sizeof(GObjectClass),
+		.class_init = dynamic_cached_class_init,
+		.instance_size = sizeof(GObject),
+	};
+	GType type = G_TYPE_INVALID;
+
+	type = gplugin_native_plugin_register_type(
+		GPLUGIN_NATIVE_PLUGIN(plugin),
+		G_TYPE_OBJECT,
+		"DynamicCachedTest",
+		&info,
+		0);
+	if(type == G_TYPE_INVALID) {
+		g_set_error(error, GPLUGIN_DOMAIN, 0, "failed to register the type");
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+dynamic_cached_unload(
+	G_GNUC_UNUSED GPluginPlugin *plugin,
+	G_GNUC_UNUSED GError **error)
+{
+	return TRUE;
+}
+
+GPLUGIN_NATIVE_PLUGIN_DECLARE(dynamic_cached)
@@ -75,6 +75,85 @@ test_dynamic_type(void)
 	g_assert_cmpint(state, ==, GPLUGIN_PLUGIN_STATE_QUERIED);
 }
 
+static void
+test_dynamic_type_cached(void)
+{
+	GPluginManager *manager = gplugin_manager_get_default();
+	GPluginPlugin *plugin = NULL;
+	GPluginNativePlugin *native = NULL;
+	GQuark quark = g_quark_from_static_string("class-init-count");
+	GObject *obj = NULL;
+	GError *error = NULL;
+	GType type = G_TYPE_INVALID;
+	gboolean ret = FALSE;
+
+	gplugin_manager_append_path(manager, TEST_DYNAMIC_DIR);
+	gplugin_manager_refresh(manager);
+
+	plugin =
+		gplugin_manager_find_plugin(manager, "gplugin/dynamic-type-cached");
+	g_assert_nonnull(plugin);
+	native = GPLUGIN_NATIVE_PLUGIN(plugin);
+
+	ret = gplugin_manager_load_plugin(manager, plugin, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	/* the type is registered but its class isn't created until it's used */
+	type = g_type_from_name("DynamicCachedTest");
+	g_assert_cmpuint(type, !=, G_TYPE_INVALID);
+	g_assert_null(g_type_class_peek(type));
+	g_assert_cmpuint(
+		gplugin_native_plugin_get_n_type_registrations(native),
+		==,
+		1);
+	g_assert_cmpuint(
+		gplugin_native_plugin_get_n_type_cache_hits(native),
+		==,
+		0);
+
+	/* the class outlives its last instance */
+	obj = g_object_new(type, NULL);
+	g_object_unref(obj);
+	g_assert_nonnull(g_type_class_peek(type));
+	g_assert_cmpuint(
+		GPOINTER_TO_UINT(g_type_get_qdata(type, quark)),
+		==,
+		1);
+
+	/* and the plugin being reloaded */
+	ret = gplugin_manager_unload_plugin(manager, plugin, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	ret = gplugin_manager_load_plugin(manager, plugin, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	g_assert_cmpuint(g_type_from_name("DynamicCachedTest"), ==, type);
+	g_assert_cmpuint(
+		gplugin_native_plugin_get_n_type_registrations(native),
+		==,
+		1);
+	g_assert_cmpuint(
+		gplugin_native_plugin_get_n_type_cache_hits(native),
+		==,
+		1);
+
+	obj = g_object_new(type, NULL);
+	g_object_unref(obj);
+	g_assert_cmpuint(
+		GPOINTER_TO_UINT(g_type_get_qdata(type, quark)),
+		==,
+		1);
+
+	ret = gplugin_manager_unload_plugin(manager, plugin, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	g_object_unref(G_OBJECT(plugin));
+}
+
 /******************************************************************************
  * Main
  *****************************************************************************/
@@ -88,6 +167,9 @@ main(gint argc, gchar **argv)
 
 	/* test dynamic types */
 	g_test_add_func("/loaders/native/dynamic-type", test_dynamic_type);
+	g_test_add_func(
+		"/loaders/native/dynamic-type/cached",
+		test_dynamic_type_cached);
 
 	return g_test_run();
 }
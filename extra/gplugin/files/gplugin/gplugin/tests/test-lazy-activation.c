@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2011-2021 Gary Kramlich <grim@reaperworld.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <gplugin.h>
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_lazy_activation_find(void)
+{
+	GPluginManager *manager = gplugin_manager_get_default();
+	GPluginPluginInfo *info = NULL;
+	GSList *proxies = NULL, *again = NULL, *l = NULL;
+
+	proxies = gplugin_manager_find_implementations(manager, "test/extension");
+	g_assert_cmpuint(g_slist_length(proxies), ==, 2);
+
+	/* the highest priority comes first */
+	info = gplugin_plugin_proxy_get_info(proxies->data);
+	g_assert_cmpstr(gplugin_plugin_info_get_id(info), ==, "gplugin/lazy-high");
+	g_object_unref(G_OBJECT(info));
+
+	/* finding them doesn't load them */
+	for(l = proxies; l != NULL; l = l->next) {
+		g_assert_false(gplugin_plugin_proxy_get_activated(l->data));
+	}
+
+	/* and every caller gets the same proxies */
+	again = gplugin_manager_find_implementations(manager, "test/extension");
+	g_assert_true(again->data == proxies->data);
+	g_assert_true(again->next->data == proxies->next->data);
+
+	g_slist_free_full(again, g_object_unref);
+	g_slist_free_full(proxies, g_object_unref);
+
+	proxies = gplugin_manager_find_implementations(manager, "test/missing");
+	g_assert_null(proxies);
+}
+
+static void
+test_lazy_activation_activate(void)
+{
+	GPluginManager *manager = gplugin_manager_get_default();
+	GPluginPlugin *plugin = NULL;
+	GSList *proxies = NULL;
+	GError *error = NULL;
+
+	proxies = gplugin_manager_find_implementations(manager, "test/extension");
+	g_assert_cmpuint(g_slist_length(proxies), ==, 2);
+
+	plugin = gplugin_plugin_proxy_activate(proxies->data, &error);
+	g_assert_no_error(error);
+	g_assert_true(GPLUGIN_IS_PLUGIN(plugin));
+	g_assert_cmpint(
+		gplugin_plugin_get_state(plugin),
+		==,
+		GPLUGIN_PLUGIN_STATE_LOADED);
+	g_assert_true(gplugin_plugin_proxy_get_activated(proxies->data));
+	g_object_unref(G_OBJECT(plugin));
+
+	/* only the plugin that was used got loaded */
+	g_assert_false(gplugin_plugin_proxy_get_activated(proxies->next->data));
+
+	/* activating again just hands back the plugin */
+	plugin = gplugin_plugin_proxy_activate(proxies->data, &error);
+	g_assert_no_error(error);
+	g_assert_true(GPLUGIN_IS_PLUGIN(plugin));
+	g_object_unref(G_OBJECT(plugin));
+
+	g_slist_free_full(proxies, g_object_unref);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv)
+{
+	GPluginManager *manager = NULL;
+
+	g_test_init(&argc, &argv, NULL);
+
+	gplugin_init(GPLUGIN_CORE_FLAGS_NONE);
+
+	manager = gplugin_manager_get_default();
+	gplugin_manager_append_path(manager, TEST_LAZY_ACTIVATION_DIR);
+	gplugin_manager_refresh(manager);
+
+	g_test_add_func("/lazy-activation/find", test_lazy_activation_find);
+	g_test_add_func("/lazy-activation/activate", test_lazy_activation_activate);
+
+	return g_test_run();
+}
@@ -104,12 +104,14 @@ test_gplugin_plugin_info_construction(void)
 	gchar *summary = NULL, *description = NULL, *category = NULL;
 	gchar *website = NULL;
 	gchar **provides = NULL, **authors = NULL, **dependencies = NULL;
+	gchar **implements = NULL;
 	gint priority = 0;
 	guint abi_version = 0;
 	gboolean internal = FALSE, load_on_query = FALSE;
 	const gchar *const r_provides[] = {"foo", NULL};
 	const gchar *const r_authors[] = {"author", NULL};
 	const gchar *const r_dependencies[] = {"dependency", NULL};
+	const gchar *const r_implements[] = {"extension-point", NULL};
 
 	/* clang-format off */
 	info = g_object_new(
@@ -132,6 +134,7 @@ test_gplugin_plugin_info_construction(void)
 		"authors", r_authors,
 		"website", "website",
 		"dependencies", r_dependencies,
+		"implements", r_implements,
 		NULL);
 	/* clang-format on */
 
@@ -158,6 +161,7 @@ test_gplugin_plugin_info_construction(void)
 		"authors", &authors,
 		"website", &website,
 		"dependencies", &dependencies,
+		"implements", &implements,
 		NULL);
 	/* clang-format on */
 
@@ -191,6 +195,11 @@ test_gplugin_plugin_info_construction(void)
 		r_dependencies,
 		(TestStringVFunc)gplugin_plugin_info_get_dependencies,
 		info);
+	test_stringv(
+		implements,
+		r_implements,
+		(TestStringVFunc)gplugin_plugin_info_get_implements,
+		info);
 
 	g_object_unref(G_OBJECT(info));
 }
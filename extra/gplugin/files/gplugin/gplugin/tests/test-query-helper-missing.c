@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2011-2021 Gary Kramlich <grim@reaperworld.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <gplugin.h>
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_query_helper_missing(void)
+{
+	GPluginManager *manager = gplugin_manager_get_default();
+	GSList *plugins = NULL;
+
+	/* the helper never starts, so the plugins are queried in process */
+	gplugin_manager_remove_paths(manager);
+	gplugin_manager_append_path(manager, TEST_DIR);
+	gplugin_manager_refresh(manager);
+
+	plugins = gplugin_manager_find_plugins_with_state(
+		manager,
+		GPLUGIN_PLUGIN_STATE_QUERIED);
+	g_assert_cmpint(g_slist_length(plugins), ==, 6);
+	g_slist_free_full(plugins, g_object_unref);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_setenv("GPLUGIN_QUERY_HELPER", "/nonexistent/gplugin-query-helper", TRUE);
+
+	gplugin_init(GPLUGIN_CORE_FLAGS_QUERY_IN_HELPER);
+
+	g_test_add_func("/query-helper/missing", test_query_helper_missing);
+
+	return g_test_run();
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2011-2021 Gary Kramlich <grim@reaperworld.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <gplugin.h>
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_query_helper_crash(void)
+{
+	GPluginManager *manager = gplugin_manager_get_default();
+	GPluginPlugin *plugin = NULL;
+
+	/* the crashing plugin is reported instead of taking us down */
+	g_test_expect_message(
+		"GPlugin",
+		G_LOG_LEVEL_WARNING,
+		"failed to query '*crash*' in the query helper: *");
+
+	gplugin_manager_remove_paths(manager);
+	gplugin_manager_append_path(manager, TEST_QUERY_CRASH_DIR);
+	gplugin_manager_refresh(manager);
+
+	g_test_assert_expected_messages();
+
+	plugin = gplugin_manager_find_plugin(
+		manager,
+		"gplugin/query-crash-survivor");
+	g_assert_nonnull(plugin);
+	g_assert_cmpint(
+		gplugin_plugin_get_state(plugin),
+		==,
+		GPLUGIN_PLUGIN_STATE_QUERIED);
+	g_object_unref(G_OBJECT(plugin));
+
+	/* the verdict is cached, so refreshing again skips the plugin without
+	 * spawning another helper.
+	 */
+	g_test_expect_message(
+		"GPlugin",
+		G_LOG_LEVEL_WARNING,
+		"failed to query '*crash*' in the query helper: *");
+
+	gplugin_manager_refresh(manager);
+
+	g_test_assert_expected_messages();
+}
+
+static void
+test_query_helper_plugins(void)
+{
+	GPluginManager *manager = gplugin_manager_get_default();
+	GSList *plugins = NULL;
+
+	/* the helper doesn't change the outcome for plugins that behave */
+	gplugin_manager_remove_paths(manager);
+	gplugin_manager_append_path(manager, TEST_DIR);
+	gplugin_manager_refresh(manager);
+
+	plugins = gplugin_manager_find_plugins_with_state(
+		manager,
+		GPLUGIN_PLUGIN_STATE_QUERIED);
+	g_assert_cmpint(g_slist_length(plugins), ==, 6);
+	g_slist_free_full(plugins, g_object_unref);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	gplugin_init(GPLUGIN_CORE_FLAGS_QUERY_IN_HELPER);
+
+	/* the plugins test counts every queried plugin, so it has to run before
+	 * the crash test adds its own.
+	 */
+	g_test_add_func("/query-helper/plugins", test_query_helper_plugins);
+	g_test_add_func("/query-helper/crash", test_query_helper_crash);
+
+	return g_test_run();
+}
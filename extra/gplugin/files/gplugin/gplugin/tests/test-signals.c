@@ -26,6 +26,9 @@ typedef struct {
 	gboolean unloaded;
 	gboolean load_failed;
 	gboolean unload_failed;
+	guint plugins_changed;
+	guint n_plugins;
+	guint state_changed;
 } TestGPluginManagerSignalsData;
 
 /******************************************************************************
@@ -135,6 +138,30 @@ test_gplugin_manager_signals_unload_failed(
 	data->unload_failed = TRUE;
 }
 
+static void
+test_gplugin_manager_signals_plugins_changed(
+	G_GNUC_UNUSED GObject *manager,
+	GList *plugins,
+	gpointer d)
+{
+	TestGPluginManagerSignalsData *data = (TestGPluginManagerSignalsData *)d;
+
+	data->plugins_changed++;
+	data->n_plugins = g_list_length(plugins);
+}
+
+static void
+test_gplugin_manager_signals_state_changed(
+	G_GNUC_UNUSED GPluginPlugin *plugin,
+	G_GNUC_UNUSED GPluginPluginState oldstate,
+	G_GNUC_UNUSED GPluginPluginState newstate,
+	gpointer d)
+{
+	TestGPluginManagerSignalsData *data = (TestGPluginManagerSignalsData *)d;
+
+	data->state_changed++;
+}
+
 /******************************************************************************
  * Tests
  *****************************************************************************/
@@ -401,6 +428,89 @@ test_gplugin_manager_signals_unload_failure(void)
 	g_signal_handler_disconnect(manager, signals[1]);
 }
 
+static void
+test_gplugin_manager_signals_batch(void)
+{
+	GPluginPlugin *plugin = NULL;
+	GPluginManager *manager = gplugin_manager_get_default();
+	GError *error = NULL;
+	TestGPluginManagerSignalsData data = {
+		.loaded = FALSE,
+		.unloaded = FALSE,
+		.plugins_changed = 0,
+		.n_plugins = 0,
+		.state_changed = 0,
+	};
+	gulong signals[] = {0, 0, 0};
+	gulong state_changed = 0;
+
+	signals[0] = g_signal_connect(
+		manager,
+		"loaded-plugin",
+		G_CALLBACK(test_gplugin_manager_signals_normal_loaded),
+		&data);
+	signals[1] = g_signal_connect(
+		manager,
+		"unloaded-plugin",
+		G_CALLBACK(test_gplugin_manager_signals_normal_unloaded),
+		&data);
+	signals[2] = g_signal_connect(
+		manager,
+		"plugins-changed",
+		G_CALLBACK(test_gplugin_manager_signals_plugins_changed),
+		&data);
+
+	gplugin_manager_append_path(manager, TEST_DIR);
+	gplugin_manager_refresh(manager);
+
+	plugin =
+		gplugin_manager_find_plugin(manager, "gplugin/native-basic-plugin");
+	state_changed = g_signal_connect(
+		plugin,
+		"state-changed",
+		G_CALLBACK(test_gplugin_manager_signals_state_changed),
+		&data);
+
+	gplugin_manager_begin_batch(manager);
+	gplugin_manager_begin_batch(manager);
+
+	gplugin_manager_load_plugin(manager, plugin, &error);
+	g_assert_no_error(error);
+	gplugin_manager_unload_plugin(manager, plugin, &error);
+	g_assert_no_error(error);
+
+	/* ending the inner batch must not emit anything */
+	gplugin_manager_end_batch(manager);
+	g_assert_cmpuint(data.plugins_changed, ==, 0);
+
+	gplugin_manager_end_batch(manager);
+	g_assert_false(data.loaded);
+	g_assert_false(data.unloaded);
+	g_assert_cmpuint(data.plugins_changed, ==, 1);
+	g_assert_cmpuint(data.n_plugins, ==, 1);
+
+	/* the plugin ended up where it started, so there's no state change */
+	g_assert_cmpuint(data.state_changed, ==, 0);
+
+	/* a load on its own is reported once the batch ends */
+	gplugin_manager_begin_batch(manager);
+	gplugin_manager_load_plugin(manager, plugin, &error);
+	g_assert_no_error(error);
+	g_assert_cmpuint(data.state_changed, ==, 0);
+	gplugin_manager_end_batch(manager);
+	g_assert_cmpuint(data.state_changed, ==, 1);
+
+	gplugin_manager_unload_plugin(manager, plugin, &error);
+	g_assert_no_error(error);
+	g_assert_cmpuint(data.state_changed, ==, 2);
+
+	g_signal_handler_disconnect(plugin, state_changed);
+	g_signal_handler_disconnect(manager, signals[0]);
+	g_signal_handler_disconnect(manager, signals[1]);
+	g_signal_handler_disconnect(manager, signals[2]);
+	g_object_unref(G_OBJECT(plugin));
+}
+
 /******************************************************************************
  * Main
  *****************************************************************************/
@@ -426,6 +536,9 @@ main(gint argc, gchar **argv)
 	g_test_add_func(
 		"/manager/signals/unload-failed",
 		test_gplugin_manager_signals_unload_failure);
+	g_test_add_func(
+		"/manager/signals/batch",
+		test_gplugin_manager_signals_batch);
 
 	return g_test_run();
 }
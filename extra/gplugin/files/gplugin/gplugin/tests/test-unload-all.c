@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2011-2021 Gary Kramlich <grim@reaperworld.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <gplugin.h>
+
+/******************************************************************************
+ * Callbacks
+ *****************************************************************************/
+static gboolean
+test_unload_all_unloading_cb(
+	G_GNUC_UNUSED GPluginManager *manager,
+	GPluginPlugin *plugin,
+	G_GNUC_UNUSED GError **error,
+	gpointer data)
+{
+	GList **order = (GList **)data;
+	GPluginPluginInfo *info = gplugin_plugin_get_info(plugin);
+
+	*order = g_list_append(*order, g_strdup(gplugin_plugin_info_get_id(info)));
+
+	g_object_unref(G_OBJECT(info));
+
+	return TRUE;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_unload_all_dependents_first(void)
+{
+	GPluginManager *manager = NULL;
+	GPluginPlugin *plugin = NULL;
+	GSList *loaded = NULL;
+	GList *order = NULL;
+	GError *error = NULL;
+	gboolean ret = FALSE;
+	gulong handler = 0;
+
+	gplugin_init(GPLUGIN_CORE_FLAGS_NONE);
+
+	manager = gplugin_manager_get_default();
+
+	gplugin_manager_append_path(manager, TEST_VERSIONED_DEPENDENCY_DIR);
+	gplugin_manager_refresh(manager);
+
+	plugin = gplugin_manager_find_plugin(manager, "gplugin/super-dependent");
+	g_assert_nonnull(plugin);
+
+	ret = gplugin_manager_load_plugin(manager, plugin, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	handler = g_signal_connect(
+		manager,
+		"unloading-plugin",
+		G_CALLBACK(test_unload_all_unloading_cb),
+		&order);
+
+	ret = gplugin_manager_unload_all(manager, 0, 0, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	/* super-dependent is the only plugin that nothing depends on, so it has
+	 * to go first, followed by the 10 plugins it depends on.
+	 */
+	g_assert_cmpuint(g_list_length(order), ==, 11);
+	g_assert_cmpstr(order->data, ==, "gplugin/super-dependent");
+
+	g_assert_cmpint(
+		gplugin_plugin_get_state(plugin),
+		==,
+		GPLUGIN_PLUGIN_STATE_QUERIED);
+
+	loaded = gplugin_manager_find_plugins_with_state(
+		manager,
+		GPLUGIN_PLUGIN_STATE_LOADED);
+	g_assert_null(loaded);
+
+	g_signal_handler_disconnect(manager, handler);
+	g_list_free_full(order, g_free);
+	g_object_unref(G_OBJECT(plugin));
+
+	gplugin_uninit();
+}
+
+static void
+test_unload_all_nothing_loaded(void)
+{
+	GPluginManager *manager = NULL;
+	GError *error = NULL;
+	gboolean ret = FALSE;
+
+	gplugin_init(GPLUGIN_CORE_FLAGS_NONE);
+
+	manager = gplugin_manager_get_default();
+
+	gplugin_manager_append_path(manager, TEST_VERSIONED_DEPENDENCY_DIR);
+	gplugin_manager_refresh(manager);
+
+	ret = gplugin_manager_unload_all(manager, 0, 0, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	gplugin_uninit();
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func(
+		"/unload-all/dependents-first",
+		test_unload_all_dependents_first);
+	g_test_add_func(
+		"/unload-all/nothing-loaded",
+		test_unload_all_nothing_loaded);
+
+	return g_test_run();
+}